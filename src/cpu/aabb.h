@@ -3,6 +3,30 @@
 
 #include "interval.h"
 
+template <typename real>
+inline void clip_to_slab(real slab_min, real slab_max, real origin, real inv_dir, bool negative,
+                         real& t_min, real& t_max)
+{
+    // Narrows [t_min, t_max] to where a ray is between the two planes of one slab. The sign of
+    // the direction says which plane the ray meets first, so the distances need no comparing,
+    // and the selects below compile to min and max instructions rather than branches.
+    //
+    // A ray parallel to the slab that starts on one of its planes computes 0 * infinity, a
+    // NaN. Each select keeps the current bound unless the comparison is true, and comparisons
+    // with a NaN are false, so such an axis leaves the interval unchanged, as a ray on the
+    // boundary should.
+    //
+    // The far distance is rounded up by the error bound of its subtraction, reciprocal and
+    // product, so that rounding never turns a ray that grazes the box into a miss, in double
+    // or in single precision.
+    real t_near = ((negative ? slab_max : slab_min) - origin) * inv_dir;
+    real t_far = ((negative ? slab_min : slab_max) - origin) * inv_dir;
+    t_far *= 1 + 2 * gamma_bound<real>(3);
+
+    t_min = t_near > t_min ? t_near : t_min;
+    t_max = t_far < t_max ? t_far : t_max;
+}
+
 class aabb
 {
   public:
@@ -40,35 +64,15 @@ class aabb
     bool hit(const ray& r, interval ray_t) const
     {
         const point3& ray_orig = r.origin();
-        const vec3& ray_dir = r.direction();
+        const vec3& inv_dir = r.inv_direction();
 
         for (int axis = 0; axis < 3; axis++)
         {
             const interval& ax = axis_interval(axis);
-            const double adinv = 1.0 / ray_dir[axis];
-
-            auto t0 = (ax.min - ray_orig[axis]) * adinv;
-            auto t1 = (ax.max - ray_orig[axis]) * adinv;
-
-            if (t0 < t1)
-            {
-                if (t0 > ray_t.min)
-                    ray_t.min = t0;
-                if (t1 < ray_t.max)
-                    ray_t.max = t1;
-            }
-            else
-            {
-                if (t1 > ray_t.min)
-                    ray_t.min = t1;
-                if (t0 < ray_t.max)
-                    ray_t.max = t0;
-            }
-
-            if (ray_t.max <= ray_t.min)
-                return false;
+            clip_to_slab(ax.min, ax.max, ray_orig[axis], inv_dir[axis], r.is_negative(axis),
+                         ray_t.min, ray_t.max);
         }
-        return true;
+        return ray_t.min < ray_t.max;
     }
 
     int longest_axis() const
@@ -82,7 +86,7 @@ class aabb
     static const aabb empty, universe;
 };
 
-const aabb aabb::empty = aabb(interval::empty, interval::empty, interval::empty);
-const aabb aabb::universe = aabb(interval::universe, interval::universe, interval::universe);
+inline const aabb aabb::empty = aabb(interval::empty, interval::empty, interval::empty);
+inline const aabb aabb::universe = aabb(interval::universe, interval::universe, interval::universe);
 
 #endif
\ No newline at end of file
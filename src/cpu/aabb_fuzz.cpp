@@ -0,0 +1,185 @@
+#include "rtweekend.h"
+
+#include "aabb.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+
+// Fuzz test of clip_to_slab(), the slab test behind aabb::hit and the compact BVH's child
+// test. Random boxes are tested against rays in float and in double, and every result is
+// compared with a long double reference that divides by the direction instead of multiplying
+// by its rounded reciprocal. A quarter of the rays are random; the rest are aimed at points on
+// box edges and corners, where rounding decides between hit and miss, and a third of those
+// run parallel to one axis from a point on one of the box's planes, where the test computes
+// 0 * infinity. The test must never miss a hit of the reference. Exits with status 1 if it
+// does. The same test without the rounded-up far distance is run alongside for comparison.
+
+struct fuzz_counts
+{
+    long cases = 0;
+    long hits = 0;         // Reference hits
+    long grazing_hits = 0; // Reference hits by rays aimed at edges and corners
+    long missed = 0;       // Reference hits the rounded-up test misses
+    long extra = 0;        // Reference misses the rounded-up test reports as hits
+    long extra_random = 0; // Of those, by random rays rather than grazing ones
+    long plain_missed = 0; // Reference hits the test without rounding misses
+};
+
+template <typename real>
+bool slab_test(const real lo[3], const real hi[3], const real origin[3], const real dir[3],
+               bool round_up)
+{
+    real t_min = 0, t_max = real(1e30);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        real inv_dir = real(1) / dir[axis];
+        bool negative = inv_dir < 0;
+        if (round_up)
+        {
+            clip_to_slab<real>(lo[axis], hi[axis], origin[axis], inv_dir, negative, t_min,
+                               t_max);
+            continue;
+        }
+
+        real t_near = ((negative ? hi[axis] : lo[axis]) - origin[axis]) * inv_dir;
+        real t_far = ((negative ? lo[axis] : hi[axis]) - origin[axis]) * inv_dir;
+        t_min = t_near > t_min ? t_near : t_min;
+        t_max = t_far < t_max ? t_far : t_max;
+    }
+    return t_min < t_max;
+}
+
+template <typename real>
+bool reference_test(const real lo[3], const real hi[3], const real origin[3], const real dir[3])
+{
+    long double t_min = 0, t_max = 1e30L;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (dir[axis] == 0)
+        {
+            if (origin[axis] < lo[axis] || origin[axis] > hi[axis])
+                return false;
+            continue;
+        }
+        long double t0 = ((long double)lo[axis] - origin[axis]) / dir[axis];
+        long double t1 = ((long double)hi[axis] - origin[axis]) / dir[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        t_min = std::max(t_min, t0);
+        t_max = std::min(t_max, t1);
+    }
+    return t_min <= t_max;
+}
+
+template <typename real> fuzz_counts fuzz(long cases, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uniform(-1, 1);
+    auto coin = [&] { return (rng() & 1) != 0; };
+
+    fuzz_counts counts;
+    for (long n = 0; n < cases; n++)
+    {
+        real lo[3], hi[3], origin[3], dir[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            real a = real(uniform(rng) * 10), b = real(uniform(rng) * 10);
+            lo[axis] = std::min(a, b);
+            hi[axis] = std::max(a, b);
+            origin[axis] = real(uniform(rng) * 30);
+        }
+
+        int kind = int(n % 4); // 0 random, 1 edge, 2 corner, 3 on a plane and parallel
+        if (kind == 0)
+        {
+            for (int axis = 0; axis < 3; axis++)
+                dir[axis] = real(uniform(rng));
+        }
+        else
+        {
+            real target[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                double t = (uniform(rng) + 1) / 2;
+                target[axis] = real(lo[axis] + t * (hi[axis] - lo[axis]));
+            }
+            int axis1 = int(rng() % 3), axis2 = int((axis1 + 1 + rng() % 2) % 3);
+            target[axis1] = coin() ? lo[axis1] : hi[axis1];
+            if (kind >= 2)
+                target[axis2] = coin() ? lo[axis2] : hi[axis2];
+
+            for (int axis = 0; axis < 3; axis++)
+                dir[axis] = target[axis] - origin[axis];
+
+            if (kind == 3)
+            {
+                int axis = int(rng() % 3);
+                dir[axis] = coin() ? real(0) : -real(0);
+                origin[axis] = coin() ? lo[axis] : hi[axis];
+            }
+        }
+
+        bool reference = reference_test(lo, hi, origin, dir);
+        bool rounded = slab_test(lo, hi, origin, dir, true);
+        bool plain = slab_test(lo, hi, origin, dir, false);
+
+        counts.cases++;
+        counts.hits += reference;
+        counts.grazing_hits += reference && kind != 0;
+        counts.missed += reference && !rounded;
+        counts.extra += !reference && rounded;
+        counts.extra_random += !reference && rounded && kind == 0;
+        counts.plain_missed += reference && !plain;
+    }
+    return counts;
+}
+
+void report(const char* precision, const fuzz_counts& c)
+{
+    auto percent = [](long part, long whole) { return whole > 0 ? 100.0 * part / whole : 0.0; };
+    std::printf("%s_cases: %ld\n", precision, c.cases);
+    std::printf("%s_reference_hits: %ld\n", precision, c.hits);
+    std::printf("%s_missed_hits: %ld\n", precision, c.missed);
+    std::printf("%s_extra_hits: %ld\n", precision, c.extra);
+    std::printf("%s_extra_hits_random_rays: %ld\n", precision, c.extra_random);
+    std::printf("%s_unrounded_missed_grazing_percent: %.2f\n", precision,
+                percent(c.plain_missed, c.grazing_hits));
+}
+
+int main(int argc, char* argv[])
+{
+    long cases = 20000000;
+    uint64_t seed = 42;
+
+    for (int i = 1; i < argc; i++)
+    {
+        auto arg = std::string(argv[i]);
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--cases" && has_value)
+            cases = std::max(1L, std::atol(argv[++i]));
+        else if (arg == "--seed" && has_value)
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            std::cerr << "Usage: aabb_fuzz [options]\n"
+                         "  --cases <n>   Cases per precision (default 20000000)\n"
+                         "  --seed <n>    Random seed (default 42)\n";
+            return 1;
+        }
+    }
+
+    auto single = fuzz<float>(cases, seed);
+    auto dbl = fuzz<double>(cases, seed);
+    report("float", single);
+    report("double", dbl);
+
+    if (single.missed > 0 || dbl.missed > 0)
+    {
+        std::cerr << "aabb_fuzz: the slab test missed hits of the reference\n";
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef ACCUMULATION_H
+#define ACCUMULATION_H
+
+// Unnormalized per-pixel radiance sums with sample counts. Renders of disjoint sample ranges
+// of the same frame produce accumulation buffers that simply add up; dividing the merged
+// sums by the merged counts gives the final image. The file format is an 8-byte magic, the
+// image width and height as int32, and then one accum_pixel record per pixel in row-major
+// order, all in native byte order.
+
+#include "color.h"
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+struct accum_pixel
+{
+    double sum[3];
+    uint32_t count;
+    uint32_t padding;
+};
+
+class accumulation_buffer
+{
+  public:
+    int width = 0;
+    int height = 0;
+    std::vector<accum_pixel> pixels;
+
+    static constexpr char magic[8] = {'P', 'T', 'A', 'C', 'C', 'U', 'M', '1'};
+
+    accumulation_buffer() {}
+
+    accumulation_buffer(int width, int height)
+        : width(width), height(height), pixels(size_t(width) * height, accum_pixel{})
+    {
+    }
+
+    void add(size_t index, const color& sum, uint32_t count)
+    {
+        auto& p = pixels[index];
+        p.sum[0] += sum.x();
+        p.sum[1] += sum.y();
+        p.sum[2] += sum.z();
+        p.count += count;
+    }
+
+    color average(size_t index) const
+    {
+        const auto& p = pixels[index];
+        if (p.count == 0)
+            return color(0, 0, 0);
+        return color(p.sum[0], p.sum[1], p.sum[2]) / p.count;
+    }
+
+    static void write_header(std::ostream& out, int width, int height)
+    {
+        int32_t dims[2] = {width, height};
+        out.write(magic, sizeof(magic));
+        out.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+    }
+
+    static bool read_header(std::istream& in, int& width, int& height)
+    {
+        char file_magic[8];
+        int32_t dims[2];
+        if (!in.read(file_magic, sizeof(file_magic)) ||
+            std::memcmp(file_magic, magic, sizeof(magic)) != 0 ||
+            !in.read(reinterpret_cast<char*>(dims), sizeof(dims)))
+            return false;
+
+        width = dims[0];
+        height = dims[1];
+        return width > 0 && height > 0;
+    }
+
+    void write(std::ostream& out) const
+    {
+        write_header(out, width, height);
+        out.write(reinterpret_cast<const char*>(pixels.data()),
+                  std::streamsize(pixels.size() * sizeof(accum_pixel)));
+    }
+
+    void write_image(std::ostream& out) const
+    {
+        out << "P3\n" << width << ' ' << height << "\n255\n";
+        for (size_t i = 0; i < pixels.size(); i++)
+            write_color(out, average(i));
+    }
+};
+
+#endif
\ No newline at end of file
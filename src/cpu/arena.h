@@ -0,0 +1,75 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+// Bump allocation for scene data. Primitives, materials and BVH nodes are created once while a
+// scene is built and all die with it, so they are carved from large blocks of a monotonic
+// buffer instead of being allocated one by one; freeing the blocks is the whole teardown.
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+class arena
+{
+  public:
+    // An arena is referenced by everything allocated from it and therefore never moves. Owners
+    // that must be movable hold it through a unique_ptr. Not thread-safe: scenes are built on
+    // one thread.
+
+    arena() : blocks(initial_block_size, &counter) {}
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    template <typename T, typename... Args> shared_ptr<T> make(Args&&... args)
+    {
+        // Like make_shared, with the object and its control block placed in the arena. Its
+        // destructor still runs when the last reference goes; only the memory is deferred.
+        return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(&blocks),
+                                       std::forward<Args>(args)...);
+    }
+
+    size_t bytes_reserved() const { return counter.bytes; }
+
+  private:
+    class counting_resource : public std::pmr::memory_resource
+    {
+      public:
+        size_t bytes = 0;
+
+      private:
+        void* do_allocate(size_t size, size_t alignment) override
+        {
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, alignment);
+        }
+
+        void do_deallocate(void* p, size_t size, size_t alignment) override
+        {
+            bytes -= size;
+            std::pmr::new_delete_resource()->deallocate(p, size, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    static constexpr size_t initial_block_size = 64 * 1024;
+
+    // Declared first so that it outlives the buffer that draws from it.
+    counting_resource counter;
+    std::pmr::monotonic_buffer_resource blocks;
+};
+
+template <typename T, typename... Args> shared_ptr<T> arena_make(arena* a, Args&&... args)
+{
+    // Allocates from `a`, or from the heap when there is no arena.
+    if (a)
+        return a->make<T>(std::forward<Args>(args)...);
+    return make_shared<T>(std::forward<Args>(args)...);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+// Renders many views of one scene in a single process. The world, BVH and lights are
+// shared read-only; the tiles of every view go into one parallel loop, so when a cheap view
+// runs out of tiles its threads steal work from the views that are still busy instead of
+// idling at a per-view barrier.
+
+#include "camera.h"
+
+#include <atomic>
+#include <execution>
+#include <vector>
+
+inline std::vector<std::vector<color>> render_views(std::vector<camera>& views,
+                                                    const hittable& world,
+                                                    const light_list& lights, int tile_size = 32)
+{
+    // Returns the normalized image of every view, row-major.
+    struct work_item
+    {
+        int view;
+        tile t;
+    };
+
+    std::vector<std::vector<color>> images(views.size());
+    std::vector<work_item> work;
+    for (size_t v = 0; v < views.size(); v++)
+    {
+        views[v].initialize();
+        int image_width = views[v].image_width;
+        int image_height = views[v].get_image_height();
+        images[v].assign(size_t(image_width) * image_height, color(0, 0, 0));
+
+        for (const auto& t : split_into_tiles(image_width, image_height, tile_size))
+            work.push_back({int(v), t});
+    }
+
+    // libstdc++ runs std::execution::par on TBB, whose scheduler balances the loop by work
+    // stealing.
+    std::atomic<size_t> remaining(work.size());
+    std::for_each(std::execution::par, work.begin(), work.end(),
+                  [&](const work_item& item)
+                  {
+                      const auto& cam = views[item.view];
+                      auto& image = images[item.view];
+                      const tile& t = item.t;
+                      for (int j = t.y0; j < t.y1; j++)
+                      {
+                          color* row = &image[size_t(j) * cam.image_width + t.x0];
+                          cam.render_tile(world, lights, tile(t.x0, j, t.x1, j + 1), 0,
+                                          cam.samples_per_pixel, row);
+                      }
+                      std::clog << "\rTiles remaining: " << --remaining << "   " << std::flush;
+                  });
+    std::clog << "\rDone.                 \n";
+
+    for (size_t v = 0; v < views.size(); v++)
+    {
+        auto pixel_samples_scale = 1.0 / views[v].samples_per_pixel;
+        for (auto& pixel_color : images[v])
+            pixel_color = pixel_samples_scale * pixel_color;
+    }
+
+    return images;
+}
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+// Renders to a wall-clock deadline instead of a fixed sample count. A first pass of one sample
+// per pixel measures how long a sample takes; after that the remaining time is spent in
+// rounds, each handing samples to the noisiest tiles first, until no further sample fits
+// before the deadline. Different tiles therefore end with different sample counts.
+
+#include "camera.h"
+
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <numeric>
+#include <vector>
+
+class budget_result
+{
+  public:
+    int image_width = 0;
+    int image_height = 0;
+    std::vector<color> image; // Normalized, row-major
+    std::vector<int> spp;     // Samples taken by every pixel
+    double seconds = 0;       // Wall-clock time actually spent
+};
+
+class budget_renderer
+{
+  public:
+    double seconds = 2; // Wall-clock budget
+    int tile_size = 32; // Tile edge length; tiles are the unit of sample allocation
+
+    budget_result render(camera& cam, const hittable& world, const light_list& lights) const
+    {
+        // The camera's samples_per_pixel is the most any pixel receives, so an easy frame can
+        // finish before the deadline.
+        using clock = std::chrono::steady_clock;
+        auto start_time = clock::now();
+        auto deadline = start_time + std::chrono::duration<double>(seconds);
+
+        cam.initialize();
+        int image_width = cam.image_width;
+        int image_height = cam.get_image_height();
+
+        std::vector<tile_state> tiles;
+        for (const auto& t : split_into_tiles(image_width, image_height, tile_size))
+            tiles.emplace_back(t);
+
+        // Calibration pass: every tile gets a sample so that the image is complete, and the
+        // pass measures the cost of one pixel sample.
+        std::vector<assignment> work;
+        for (size_t i = 0; i < tiles.size(); i++)
+            work.push_back({i, 1});
+
+        double pixel_samples = 0, elapsed = 0;
+        while (!work.empty())
+        {
+            auto round_start = clock::now();
+            std::for_each(std::execution::par, work.begin(), work.end(),
+                          [&](const assignment& a)
+                          { tiles[a.tile].add_samples(cam, world, lights, a.samples); });
+            auto round_end = clock::now();
+
+            for (const auto& a : work)
+                pixel_samples += double(a.samples) * tiles[a.tile].t.pixel_count();
+            elapsed += std::chrono::duration<double>(round_end - round_start).count();
+            double seconds_per_sample = elapsed / pixel_samples;
+
+            // Plan the next round to take half of the time left, so the estimate is refreshed
+            // as the deadline nears and the last round overshoots by little.
+            double remaining = std::chrono::duration<double>(deadline - round_end).count();
+            work = plan_round(tiles, cam.samples_per_pixel, 0.5 * remaining / seconds_per_sample);
+        }
+
+        budget_result result;
+        result.image_width = image_width;
+        result.image_height = image_height;
+        result.image.resize(size_t(image_width) * image_height);
+        result.spp.resize(result.image.size());
+        for (const auto& ts : tiles)
+        {
+            const tile& t = ts.t;
+            for (int j = t.y0; j < t.y1; j++)
+            {
+                for (int i = t.x0; i < t.x1; i++)
+                {
+                    size_t k = size_t(j - t.y0) * t.width() + (i - t.x0);
+                    result.image[size_t(j) * image_width + i] = ts.sums[k] / ts.samples;
+                    result.spp[size_t(j) * image_width + i] = ts.samples;
+                }
+            }
+        }
+        result.seconds = std::chrono::duration<double>(clock::now() - start_time).count();
+        return result;
+    }
+
+  private:
+    struct assignment
+    {
+        size_t tile;
+        int samples;
+    };
+
+    class tile_state
+    {
+      public:
+        tile t;
+        int samples = 0;
+        std::vector<color> sums;
+        std::vector<double> mean, m2; // Running luminance statistics per pixel (Welford)
+
+        explicit tile_state(const tile& t)
+            : t(t), sums(t.pixel_count()), mean(t.pixel_count()), m2(t.pixel_count())
+        {
+        }
+
+        void add_samples(const camera& cam, const hittable& world, const light_list& lights,
+                         int count)
+        {
+            // Samples are taken one at a time to keep per-pixel variance statistics. Sample
+            // indices continue where the tile left off, so the sampler's sequence is intact.
+            std::vector<color> sample(t.pixel_count());
+            for (int s = samples; s < samples + count; s++)
+            {
+                std::fill(sample.begin(), sample.end(), color(0, 0, 0));
+                cam.render_tile(world, lights, t, s, s + 1, sample.data());
+
+                double n = s + 1;
+                for (size_t k = 0; k < sample.size(); k++)
+                {
+                    sums[k] += sample[k];
+                    auto y = luminance(sample[k]);
+                    auto delta = y - mean[k];
+                    mean[k] += delta / n;
+                    m2[k] += delta * (y - mean[k]);
+                }
+            }
+            samples += count;
+        }
+
+        double error() const
+        {
+            // Mean standard error of the pixels after the gamma 2 transform write_color
+            // applies; d(sqrt(y)) = dy / (2 sqrt(y)), so dark noise counts for more.
+            if (samples < 2)
+                return infinity;
+
+            double total = 0;
+            for (size_t k = 0; k < mean.size(); k++)
+            {
+                auto standard_error = std::sqrt(m2[k] / (samples - 1) / samples);
+                total += standard_error / (2 * std::sqrt(std::fmax(mean[k], 1e-3)));
+            }
+            return total / mean.size();
+        }
+    };
+
+    static double luminance(const color& c)
+    {
+        return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+    }
+
+    static std::vector<assignment> plan_round(const std::vector<tile_state>& tiles,
+                                              int max_samples, double pixel_samples)
+    {
+        // Hands out about `pixel_samples` pixel samples, visiting tiles from the noisiest down.
+        // Each tile is offered a share in proportion to its error, and at least one sample, so
+        // the noisiest tiles are served first when the budget does not reach every tile.
+        std::vector<size_t> order;
+        std::vector<double> errors(tiles.size());
+        double total_error = 0;
+        for (size_t i = 0; i < tiles.size(); i++)
+        {
+            if (tiles[i].samples >= max_samples)
+                continue;
+            errors[i] = tiles[i].error();
+            order.push_back(i);
+        }
+        std::sort(order.begin(), order.end(),
+                  [&](size_t a, size_t b) { return errors[a] > errors[b]; });
+
+        // Untouched tiles (infinite error) split the budget evenly among themselves.
+        bool any_infinite = !order.empty() && errors[order.front()] == infinity;
+        for (auto i : order)
+            total_error += any_infinite ? (errors[i] == infinity) : errors[i];
+
+        std::vector<assignment> work;
+        double budget = pixel_samples;
+        for (auto i : order)
+        {
+            double pixels = tiles[i].t.pixel_count();
+            if (budget < pixels)
+                break;
+
+            double weight = any_infinite ? (errors[i] == infinity) : errors[i];
+            int share = 1;
+            if (total_error > 0)
+                share = int(pixel_samples * weight / total_error / pixels);
+            int samples = std::clamp(share, 1, max_samples - tiles[i].samples);
+            samples = std::min(samples, int(budget / pixels));
+
+            work.push_back({i, samples});
+            budget -= samples * pixels;
+        }
+        return work;
+    }
+};
+
+#endif
\ No newline at end of file
@@ -4,25 +4,36 @@
 #include <algorithm>
 
 #include "aabb.h"
+#include "arena.h"
 #include "hittable.h"
 #include "hittable_list.h"
+#include "traversal_stats.h"
 
 class bvh_node : public hittable
 {
   public:
-    bvh_node(hittable_list list) : bvh_node(list.objects, 0, list.objects.size()) {}
+    // Interior nodes are allocated from `mem` when one is given, otherwise from the heap.
 
-    bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end)
+    bvh_node(hittable_list list, arena* mem = nullptr)
+        : bvh_node(list.objects, 0, list.objects.size(), mem)
     {
-        // Build the bounding box of the span of source objects.
+    }
+
+    bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end,
+             arena* mem = nullptr)
+    {
+        // Build the bounding boxes of the span of source objects at shutter open and close.
         bbox = aabb::empty;
+        bbox_close = aabb::empty;
         for (size_t i = start; i < end; i++)
         {
-            bbox = aabb(objects[i]->bounding_box(), bbox);
+            bbox = aabb(objects[i]->bounds_at(0), bbox);
+            bbox_close = aabb(objects[i]->bounds_at(1), bbox_close);
         }
+        moving = !same_box(bbox, bbox_close);
 
         // Pick an axis to split on
-        int axis = bbox.longest_axis();
+        axis = bounding_box().longest_axis();
 
         // Sort the primitives
         auto comparator = (axis == 0) ? box_x_compare : (axis == 1) ? box_y_compare : box_z_compare;
@@ -36,8 +47,11 @@ class bvh_node : public hittable
         }
         else if (object_span == 2)
         {
+            // Ordered like the halves below, so that traversal's near-first choice holds.
             left = objects[start];
             right = objects[start + 1];
+            if (comparator(right, left))
+                std::swap(left, right);
         }
         else
         {
@@ -45,28 +59,80 @@ class bvh_node : public hittable
             std::sort(objects.begin() + start, objects.begin() + end, comparator);
 
             auto mid = start + object_span / 2;
-            left = make_shared<bvh_node>(objects, start, mid);
-            right = make_shared<bvh_node>(objects, mid, end);
+            left = arena_make<bvh_node>(mem, objects, start, mid, mem);
+            right = arena_make<bvh_node>(mem, objects, mid, end, mem);
         }
     }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override
     {
-        if (!bbox.hit(r, ray_t))
+        COUNT_TRAVERSAL(nodes, 1);
+        if (!(moving ? bounds_at(r.time()) : bbox).hit(r, ray_t))
+            return false;
+
+        // The left child holds the primitives lower along the split axis, so it is the nearer
+        // one for rays heading up that axis. Visiting the nearer child first lets its hit cut
+        // the interval searched in the farther one.
+        bool right_first = r.is_negative(axis);
+        const auto& near_child = right_first ? right : left;
+        const auto& far_child = right_first ? left : right;
+
+        bool hit_near = near_child->hit(r, ray_t, rec);
+        if (far_child == near_child)
+            return hit_near;
+
+        bool hit_far = far_child->hit(r, interval(ray_t.min, hit_near ? rec.t : ray_t.max), rec);
+        return hit_near || hit_far;
+    }
+
+    bool occluded(const ray& r, interval ray_t) const override
+    {
+        COUNT_TRAVERSAL(nodes, 1);
+        if (!(moving ? bounds_at(r.time()) : bbox).hit(r, ray_t))
             return false;
 
-        bool hit_left = left->hit(r, ray_t, rec);
-        bool hit_right = right->hit(r, interval(ray_t.min, hit_left ? rec.t : ray_t.max), rec);
+        bool right_first = r.is_negative(axis);
+        const auto& near_child = right_first ? right : left;
+        const auto& far_child = right_first ? left : right;
 
-        return hit_left || hit_right;
+        return near_child->occluded(r, ray_t) ||
+               (far_child != near_child && far_child->occluded(r, ray_t));
     }
 
-    aabb bounding_box() const override { return bbox; }
+    aabb bounding_box() const override { return moving ? aabb(bbox, bbox_close) : bbox; }
+
+    aabb bounds_at(double time) const override
+    {
+        // Every primitive below moves linearly, so its box at `time` lies within the box
+        // interpolated between the node's boxes at shutter open and close.
+        if (!moving)
+            return bbox;
+
+        auto lerp = [time](const interval& a, const interval& b)
+        { return interval(a.min + time * (b.min - a.min), a.max + time * (b.max - a.max)); };
+        return aabb(lerp(bbox.x, bbox_close.x), lerp(bbox.y, bbox_close.y),
+                    lerp(bbox.z, bbox_close.z));
+    }
 
   private:
     shared_ptr<hittable> left;
     shared_ptr<hittable> right;
-    aabb bbox;
+    aabb bbox;       // At shutter open, time 0
+    aabb bbox_close; // At shutter close, time 1
+    bool moving;     // Whether the two boxes differ
+    int axis;        // The axis the primitives were sorted along
+
+    static bool same_box(const aabb& a, const aabb& b)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const interval& p = a.axis_interval(axis);
+            const interval& q = b.axis_interval(axis);
+            if (p.min != q.min || p.max != q.max)
+                return false;
+        }
+        return true;
+    }
 
     static bool box_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b,
                             int axis_index)
@@ -0,0 +1,782 @@
+#ifndef BVH_BUILD_H
+#define BVH_BUILD_H
+
+// Binary BVH topology produced by the builders, before it is converted into a traversal layout
+// such as compact_bvh. Nodes refer to primitives by index into the builder's input.
+
+#include "aabb.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <execution>
+#include <functional>
+#include <numeric>
+#include <vector>
+
+class bvh_build
+{
+  public:
+    struct node
+    {
+        aabb bounds;
+        int left = -1, right = -1; // Children of interior nodes
+        int first = 0, count = 0;  // Range of `refs` held by a leaf; count is 0 for interior
+                                   // nodes
+
+        bool is_leaf() const { return count > 0; }
+    };
+
+    std::vector<node> nodes; // nodes[0] is the root
+    std::vector<int> refs;   // Primitive indices, grouped by leaf
+
+    static bvh_build median_split(const std::vector<aabb>& boxes, int max_leaf_size = 2)
+    {
+        // The same partitioning as bvh_node: split the longest axis of each node's bounds at
+        // the median of the primitives' lower box corners.
+        bvh_build b;
+        b.refs.resize(boxes.size());
+        std::iota(b.refs.begin(), b.refs.end(), 0);
+        if (!boxes.empty())
+            b.build_median(boxes, 0, boxes.size(), std::max(1, max_leaf_size));
+        return b;
+    }
+
+    // Returns the bounds of the part of primitive `index` inside `region`; any box containing
+    // that part is valid.
+    using clip_function = std::function<aabb(int index, const aabb& region)>;
+
+    static bvh_build spatial_split(const std::vector<aabb>& boxes, const clip_function& clip,
+                                   double max_growth = 0.3, int max_leaf_size = 2)
+    {
+        // A split BVH (Stich et al., "Spatial Splits in Bounding Volume Hierarchies"). Each
+        // node takes the cheaper, by the surface area heuristic, of a binned object split and,
+        // where the children of that split overlap, a spatial split: a plane that cuts the
+        // primitives straddling it into a clipped reference on either side. Large primitives
+        // then stop inflating every node around them. References may grow to
+        // (1 + max_growth) times the primitive count, after which only object splits are made.
+        bvh_build b;
+        if (boxes.empty())
+            return b;
+
+        std::vector<reference> refs(boxes.size());
+        aabb bounds = aabb::empty;
+        for (size_t i = 0; i < boxes.size(); i++)
+        {
+            refs[i] = {boxes[i], int(i)};
+            bounds = aabb(bounds, boxes[i]);
+        }
+
+        split_builder builder{b, clip, std::max(1, max_leaf_size)};
+        builder.root_area = surface_area(bounds);
+        builder.refs_left = size_t(double(boxes.size()) * std::max(0.0, max_growth));
+        builder.build(std::move(refs), bounds);
+        return b;
+    }
+
+    static bvh_build morton(const std::vector<aabb>& boxes, int code_bits = 63,
+                            bool restructure = false)
+    {
+        // A linear BVH (Karras, "Maximizing Parallelism in the Construction of BVHs, Octrees,
+        // and k-d Trees"): the primitives are sorted along a Morton curve through their
+        // centroids, with 30-bit codes (10 bits per axis) or 63-bit codes (21 bits per axis),
+        // and every interior node is then found independently of the others from the sorted
+        // codes alone. Each step runs in parallel. The tree has one primitive per leaf and
+        // roughly median splits in space, so it traces slower than a SAH build; `restructure`
+        // recovers much of that with restructure_treelets().
+        bvh_build b;
+        size_t n = boxes.size();
+        if (n == 0)
+            return b;
+
+        int axis_bits = code_bits <= 30 ? 10 : 21;
+        auto keys = morton_codes(boxes, axis_bits);
+        b.refs.resize(n);
+        std::iota(b.refs.begin(), b.refs.end(), 0);
+        radix_sort(keys, b.refs, 3 * axis_bits);
+
+        // Interior nodes occupy [0, n - 1), the root first, and leaf j is node n - 1 + j.
+        b.nodes.resize(2 * n - 1);
+        std::vector<int> parent(2 * n - 1, -1);
+        for_each_index(n - 1,
+                       [&](size_t i)
+                       {
+                           auto& node = b.nodes[i];
+                           karras_split(keys, int(i), node.left, node.right);
+                           node.left = node.left < 0 ? int(n - 1) + ~node.left : node.left;
+                           node.right = node.right < 0 ? int(n - 1) + ~node.right : node.right;
+                           parent[node.left] = int(i);
+                           parent[node.right] = int(i);
+                       });
+
+        // Bounds, bottom up: of the two threads that arrive at a node from its children, the
+        // second finds both children done and carries on towards the root.
+        std::vector<std::atomic<int>> arrivals(n > 1 ? n - 1 : 1);
+        for_each_index(n,
+                       [&](size_t j)
+                       {
+                           int index = int(n - 1 + j);
+                           b.nodes[index].bounds = boxes[b.refs[j]];
+                           b.nodes[index].first = int(j);
+                           b.nodes[index].count = 1;
+
+                           for (int p = parent[index]; p >= 0; p = parent[p])
+                           {
+                               if (arrivals[p].fetch_add(1, std::memory_order_acq_rel) == 0)
+                                   break;
+                               auto& node = b.nodes[p];
+                               node.bounds = aabb(b.nodes[node.left].bounds,
+                                                  b.nodes[node.right].bounds);
+                           }
+                       });
+
+        if (restructure)
+            b.restructure_treelets();
+        return b;
+    }
+
+    void restructure_treelets()
+    {
+        // Treelet restructuring (Karras and Aila, "Fast Parallel Construction of High-Quality
+        // Bounding Volume Hierarchies"). Bottom up, every interior node roots a treelet grown
+        // to treelet_leaves leaves by opening its largest interior leaf, and the treelet is
+        // rebuilt with the topology of least total surface area over those leaves, found by
+        // dynamic programming over their subsets. The leaves' subtrees stay as they are.
+        std::vector<int> post_order;
+        post_order.reserve(nodes.size());
+        std::vector<int> pending = {0};
+        while (!pending.empty())
+        {
+            int index = pending.back();
+            pending.pop_back();
+            post_order.push_back(index);
+            if (!nodes[index].is_leaf())
+            {
+                pending.push_back(nodes[index].left);
+                pending.push_back(nodes[index].right);
+            }
+        }
+
+        treelet t;
+        for (auto it = post_order.rbegin(); it != post_order.rend(); ++it)
+        {
+            if (!nodes[*it].is_leaf())
+                optimize_treelet(*it, t);
+        }
+    }
+
+    double sah_cost(double node_cost = 1, double primitive_cost = 1) const
+    {
+        // The surface area heuristic's estimate of the cost of tracing a ray that hits the
+        // root: the chance of reaching each node, its area over the root's, times the cost of
+        // visiting it, one box test for interior nodes and its primitives for leaves.
+        if (nodes.empty() || surface_area(nodes[0].bounds) <= 0)
+            return 0;
+
+        double total = 0;
+        for (const auto& n : nodes)
+            total += surface_area(n.bounds) * (n.is_leaf() ? n.count * primitive_cost : node_cost);
+        return total / surface_area(nodes[0].bounds);
+    }
+
+    double overlap() const
+    {
+        // Sum of the surface areas of the intersections of every interior node's two child
+        // boxes, relative to the root's. Rays in an overlap must descend into both children.
+        if (nodes.empty() || surface_area(nodes[0].bounds) <= 0)
+            return 0;
+
+        double total = 0;
+        for (const auto& n : nodes)
+        {
+            if (!n.is_leaf())
+                total += surface_area(intersect(nodes[n.left].bounds, nodes[n.right].bounds));
+        }
+        return total / surface_area(nodes[0].bounds);
+    }
+
+    static double surface_area(const aabb& box)
+    {
+        double dx = box.x.size(), dy = box.y.size(), dz = box.z.size();
+        if (dx < 0 || dy < 0 || dz < 0)
+            return 0;
+        return 2 * (dx * dy + dy * dz + dz * dx);
+    }
+
+  private:
+    struct reference
+    {
+        aabb box; // Bounds of the part of the primitive this reference stands for
+        int index;
+    };
+
+    struct split_builder
+    {
+        static constexpr int bin_count = 32;
+        static constexpr double min_overlap = 1e-5; // Of the root area, to try spatial splits
+
+        bvh_build& b;
+        const clip_function& clip;
+        int max_leaf_size;
+        double root_area = 0;
+        size_t refs_left = 0; // Further references that spatial splits may create
+
+        struct split
+        {
+            double cost = infinity;
+            int axis = -1;
+            double position = 0; // Centroid threshold or plane
+            aabb left, right;
+        };
+
+        int build(std::vector<reference> refs, const aabb& bounds)
+        {
+            int index = int(b.nodes.size());
+            b.nodes.emplace_back();
+            b.nodes[index].bounds = bounds;
+
+            if (refs.size() <= size_t(max_leaf_size))
+                return make_leaf(index, refs);
+
+            split object = object_split(refs);
+            split spatial;
+            if (refs_left > 0 &&
+                surface_area(intersect(object.left, object.right)) > min_overlap * root_area)
+                spatial = spatial_split(refs, bounds);
+
+            std::vector<reference> left, right;
+            if (spatial.cost < object.cost)
+                partition_spatial(refs, spatial, left, right);
+            if (left.empty() || right.empty())
+                partition_object(refs, object, left, right);
+            refs = std::vector<reference>();
+
+            aabb left_bounds = aabb::empty, right_bounds = aabb::empty;
+            for (const auto& r : left)
+                left_bounds = aabb(left_bounds, r.box);
+            for (const auto& r : right)
+                right_bounds = aabb(right_bounds, r.box);
+
+            int left_index = build(std::move(left), left_bounds);
+            int right_index = build(std::move(right), right_bounds);
+            b.nodes[index].left = left_index;
+            b.nodes[index].right = right_index;
+            return index;
+        }
+
+        int make_leaf(int index, const std::vector<reference>& refs)
+        {
+            b.nodes[index].first = int(b.refs.size());
+            b.nodes[index].count = int(refs.size());
+            for (const auto& r : refs)
+                b.refs.push_back(r.index);
+            return index;
+        }
+
+        static double centroid(const reference& r, int axis)
+        {
+            const interval& ax = r.box.axis_interval(axis);
+            return 0.5 * (ax.min + ax.max);
+        }
+
+        split object_split(const std::vector<reference>& refs) const
+        {
+            // Bins the references by centroid along each axis and sweeps the bin boundaries.
+            aabb centroids = aabb::empty;
+            for (const auto& r : refs)
+            {
+                point3 c(centroid(r, 0), centroid(r, 1), centroid(r, 2));
+                centroids = aabb(centroids, aabb(c, c));
+            }
+
+            split best;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const interval& extent = centroids.axis_interval(axis);
+                if (extent.size() <= 0)
+                    continue;
+
+                aabb bins[bin_count];
+                size_t counts[bin_count] = {};
+                for (const auto& r : refs)
+                {
+                    int bin = object_bin(centroid(r, axis), extent);
+                    bins[bin] = aabb(bins[bin], r.box);
+                    counts[bin]++;
+                }
+
+                sweep(bins, counts, counts, axis, best,
+                      [&](int i) { return extent.min + extent.size() * (i + 1) / bin_count; });
+            }
+            return best;
+        }
+
+        static int object_bin(double c, const interval& extent)
+        {
+            int bin = int(bin_count * (c - extent.min) / extent.size());
+            return std::max(0, std::min(bin_count - 1, bin));
+        }
+
+        split spatial_split(const std::vector<reference>& refs, const aabb& bounds) const
+        {
+            // Bins the node's bounds into slabs along each axis. A reference counts towards the
+            // left of every plane past the slab it starts in and towards the right of every
+            // plane before the slab it ends in, and each slab's box grows by the reference
+            // clipped to it.
+            split best;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const interval& extent = bounds.axis_interval(axis);
+                if (extent.size() <= 0)
+                    continue;
+                auto plane = [&](int i) { return extent.min + extent.size() * i / bin_count; };
+
+                aabb bins[bin_count];
+                size_t entries[bin_count] = {}, exits[bin_count] = {};
+                for (const auto& r : refs)
+                {
+                    const interval& ax = r.box.axis_interval(axis);
+                    int first = object_bin(ax.min, extent), last = object_bin(ax.max, extent);
+                    entries[first]++;
+                    exits[last]++;
+                    for (int bin = first; bin <= last; bin++)
+                    {
+                        interval slab(std::max(ax.min, plane(bin)),
+                                      std::min(ax.max, plane(bin + 1)));
+                        bins[bin] = aabb(bins[bin], clipped(r, axis, slab));
+                    }
+                }
+
+                sweep(bins, entries, exits, axis, best, [&](int i) { return plane(i + 1); });
+            }
+            return best;
+        }
+
+        template <typename position_function>
+        static void sweep(const aabb* bins, const size_t* left_counts, const size_t* right_counts,
+                          int axis, split& best, position_function position)
+        {
+            // Evaluates the split after every bin but the last: the surface area heuristic
+            // cost, up to constant factors, is each side's area times its reference count.
+            aabb right_boxes[bin_count];
+            size_t right_totals[bin_count];
+            aabb box = aabb::empty;
+            size_t total = 0;
+            for (int i = bin_count - 1; i > 0; i--)
+            {
+                box = aabb(box, bins[i]);
+                total += right_counts[i];
+                right_boxes[i] = box;
+                right_totals[i] = total;
+            }
+
+            box = aabb::empty;
+            total = 0;
+            for (int i = 0; i < bin_count - 1; i++)
+            {
+                box = aabb(box, bins[i]);
+                total += left_counts[i];
+                if (total == 0 || right_totals[i + 1] == 0)
+                    continue;
+
+                double cost = surface_area(box) * total +
+                              surface_area(right_boxes[i + 1]) * right_totals[i + 1];
+                if (cost < best.cost)
+                    best = {cost, axis, position(i), box, right_boxes[i + 1]};
+            }
+        }
+
+        aabb clipped(const reference& r, int axis, const interval& slab) const
+        {
+            // The reference's part within `slab` along `axis`, tightened by the primitive.
+            aabb region = r.box;
+            if (axis == 0)
+                region.x = slab;
+            else if (axis == 1)
+                region.y = slab;
+            else
+                region.z = slab;
+            return intersect(clip(r.index, region), region);
+        }
+
+        static bool is_empty(const aabb& box)
+        {
+            return box.x.size() < 0 || box.y.size() < 0 || box.z.size() < 0;
+        }
+
+        void partition_object(std::vector<reference>& refs, const split& s,
+                              std::vector<reference>& left, std::vector<reference>& right) const
+        {
+            left.clear();
+            right.clear();
+            if (s.axis >= 0)
+            {
+                for (const auto& r : refs)
+                    (centroid(r, s.axis) < s.position ? left : right).push_back(r);
+            }
+
+            if (left.empty() || right.empty())
+            {
+                // Every centroid coincides: halve the list as it stands.
+                left.assign(refs.begin(), refs.begin() + refs.size() / 2);
+                right.assign(refs.begin() + refs.size() / 2, refs.end());
+            }
+        }
+
+        void partition_spatial(std::vector<reference>& refs, const split& s,
+                               std::vector<reference>& left, std::vector<reference>& right)
+        {
+            size_t straddling = 0;
+            for (const auto& r : refs)
+            {
+                const interval& ax = r.box.axis_interval(s.axis);
+                straddling += ax.min < s.position && s.position < ax.max;
+            }
+            if (straddling > refs_left)
+                return;
+
+            for (const auto& r : refs)
+            {
+                const interval& ax = r.box.axis_interval(s.axis);
+                if (ax.max <= s.position)
+                {
+                    left.push_back(r);
+                }
+                else if (ax.min >= s.position)
+                {
+                    right.push_back(r);
+                }
+                else
+                {
+                    // Primitives whose clipped part on one side turns out to be empty only
+                    // go to the other.
+                    aabb l = clipped(r, s.axis, interval(ax.min, s.position));
+                    aabb h = clipped(r, s.axis, interval(s.position, ax.max));
+                    if (!is_empty(l))
+                        left.push_back({l, r.index});
+                    if (!is_empty(h))
+                        right.push_back({h, r.index});
+                }
+            }
+
+            if (left.empty() || right.empty())
+            {
+                left.clear();
+                right.clear();
+                return;
+            }
+            refs_left -= std::min(refs_left, left.size() + right.size() - refs.size());
+        }
+    };
+
+    static constexpr int treelet_leaves = 7;
+
+    struct treelet
+    {
+        static constexpr int subsets = 1 << treelet_leaves;
+
+        int leaves[treelet_leaves];
+        int interior[treelet_leaves - 1]; // Node indices reused for the rebuilt topology
+        aabb boxes[subsets];              // Bounds of every subset of the leaves
+        double cost[subsets];             // Least total area of a subtree over each subset
+        int split[subsets];               // The subset of its left child in that subtree
+    };
+
+    void optimize_treelet(int root, treelet& t)
+    {
+        int leaf_count = 2, interior_count = 1;
+        t.leaves[0] = nodes[root].left;
+        t.leaves[1] = nodes[root].right;
+        t.interior[0] = root;
+        while (leaf_count < treelet_leaves)
+        {
+            int largest = -1;
+            double largest_area = -1;
+            for (int k = 0; k < leaf_count; k++)
+            {
+                const auto& n = nodes[t.leaves[k]];
+                if (!n.is_leaf() && surface_area(n.bounds) > largest_area)
+                {
+                    largest = k;
+                    largest_area = surface_area(n.bounds);
+                }
+            }
+            if (largest < 0)
+                break;
+
+            int opened = t.leaves[largest];
+            t.interior[interior_count++] = opened;
+            t.leaves[largest] = nodes[opened].left;
+            t.leaves[leaf_count++] = nodes[opened].right;
+        }
+        if (leaf_count < 3)
+            return;
+
+        // Subsets in increasing order see every proper subset of themselves first.
+        int full = (1 << leaf_count) - 1;
+        for (int s = 1; s <= full; s++)
+        {
+            int low = s & -s;
+            int k = 0;
+            while ((1 << k) != low)
+                k++;
+
+            if (s == low)
+            {
+                t.boxes[s] = nodes[t.leaves[k]].bounds;
+                t.cost[s] = 0;
+                continue;
+            }
+
+            t.boxes[s] = aabb(t.boxes[s ^ low], nodes[t.leaves[k]].bounds);
+
+            // Each split is tried once, as the part holding the lowest leaf of s.
+            double best = infinity;
+            for (int part = (s - 1) & s; part > 0; part = (part - 1) & s)
+            {
+                if (!(part & low))
+                    continue;
+                double c = t.cost[part] + t.cost[s ^ part];
+                if (c < best)
+                {
+                    best = c;
+                    t.split[s] = part;
+                }
+            }
+            t.cost[s] = surface_area(t.boxes[s]) + best;
+        }
+
+        int next = 1;
+        rebuild_treelet(t, full, root, next);
+    }
+
+    void rebuild_treelet(const treelet& t, int s, int index, int& next)
+    {
+        int sides[2] = {t.split[s], s ^ t.split[s]};
+        int children[2];
+        for (int k = 0; k < 2; k++)
+        {
+            int side = sides[k];
+            if ((side & (side - 1)) == 0)
+            {
+                int leaf = 0;
+                while ((1 << leaf) != side)
+                    leaf++;
+                children[k] = t.leaves[leaf];
+            }
+            else
+            {
+                children[k] = t.interior[next++];
+                rebuild_treelet(t, side, children[k], next);
+            }
+        }
+
+        nodes[index].left = children[0];
+        nodes[index].right = children[1];
+        nodes[index].bounds = t.boxes[s];
+    }
+
+    template <typename function> static void for_each_index(size_t count, function f)
+    {
+        std::vector<size_t> indices(count);
+        std::iota(indices.begin(), indices.end(), size_t(0));
+        std::for_each(std::execution::par, indices.begin(), indices.end(), f);
+    }
+
+    static uint64_t spread_bits(uint64_t x)
+    {
+        // Moves bit k of the low 21 bits of x to bit 3k.
+        x &= 0x1fffff;
+        x = (x | x << 32) & 0x1f00000000ffffULL;
+        x = (x | x << 16) & 0x1f0000ff0000ffULL;
+        x = (x | x << 8) & 0x100f00f00f00f00fULL;
+        x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+        x = (x | x << 2) & 0x1249249249249249ULL;
+        return x;
+    }
+
+    static std::vector<uint64_t> morton_codes(const std::vector<aabb>& boxes, int axis_bits)
+    {
+        aabb centroids = aabb::empty;
+        for (const auto& box : boxes)
+        {
+            point3 c(0.5 * (box.x.min + box.x.max), 0.5 * (box.y.min + box.y.max),
+                     0.5 * (box.z.min + box.z.max));
+            centroids = aabb(centroids, aabb(c, c));
+        }
+
+        // One scale for all axes, so that a flat scene spends its leading code bits on its
+        // wide axes instead of splitting early across its thin one.
+        double size = std::max({centroids.x.size(), centroids.y.size(), centroids.z.size()});
+        double cells = double(uint64_t(1) << axis_bits);
+        double scale = size > 0 ? cells / size : 0;
+        std::vector<uint64_t> keys(boxes.size());
+        for_each_index(boxes.size(),
+                       [&](size_t i)
+                       {
+                           uint64_t key = 0;
+                           for (int axis = 0; axis < 3; axis++)
+                           {
+                               const interval& ax = boxes[i].axis_interval(axis);
+                               double c = 0.5 * (ax.min + ax.max);
+                               double u = (c - centroids.axis_interval(axis).min) * scale;
+                               auto cell = uint64_t(std::clamp(u, 0.0, cells - 1));
+                               key |= spread_bits(cell) << (2 - axis);
+                           }
+                           keys[i] = key;
+                       });
+        return keys;
+    }
+
+    static void radix_sort(std::vector<uint64_t>& keys, std::vector<int>& values, int key_bits)
+    {
+        // Least significant digit first, radix_bits per pass. Each pass splits the arrays into
+        // blocks that count their digits and then scatter them in parallel; a prefix sum over
+        // the counts, digit major and block minor, keeps the sort stable. A pass in which all
+        // keys share the digit would move nothing and is skipped.
+        constexpr int radix_bits = 11;
+        constexpr size_t radix = size_t(1) << radix_bits;
+        const size_t n = keys.size();
+        const size_t block_size = 1 << 16;
+        const size_t block_count = (n + block_size - 1) / block_size;
+
+        std::vector<uint64_t> key_buffer(n);
+        std::vector<int> value_buffer(n);
+        std::vector<size_t> offsets(block_count * radix);
+
+        for (int shift = 0; shift < key_bits; shift += radix_bits)
+        {
+            std::fill(offsets.begin(), offsets.end(), 0);
+            for_each_index(block_count,
+                           [&](size_t block)
+                           {
+                               size_t* count = &offsets[block * radix];
+                               size_t end = std::min(n, (block + 1) * block_size);
+                               for (size_t i = block * block_size; i < end; i++)
+                                   count[(keys[i] >> shift) & (radix - 1)]++;
+                           });
+
+            size_t sum = 0;
+            bool one_digit = false;
+            for (size_t digit = 0; digit < radix; digit++)
+            {
+                size_t digit_start = sum;
+                for (size_t block = 0; block < block_count; block++)
+                {
+                    size_t count = offsets[block * radix + digit];
+                    offsets[block * radix + digit] = sum;
+                    sum += count;
+                }
+                one_digit |= sum - digit_start == n;
+            }
+            if (one_digit)
+                continue;
+
+            for_each_index(block_count,
+                           [&](size_t block)
+                           {
+                               size_t* next = &offsets[block * radix];
+                               size_t end = std::min(n, (block + 1) * block_size);
+                               for (size_t i = block * block_size; i < end; i++)
+                               {
+                                   size_t to = next[(keys[i] >> shift) & (radix - 1)]++;
+                                   key_buffer[to] = keys[i];
+                                   value_buffer[to] = values[i];
+                               }
+                           });
+
+            keys.swap(key_buffer);
+            values.swap(value_buffer);
+        }
+    }
+
+    static int common_prefix(const std::vector<uint64_t>& keys, int i, int j)
+    {
+        // Length of the common prefix of keys i and j, with their indices appended to break
+        // ties between equal keys, or -1 when j is out of range.
+        if (j < 0 || j >= int(keys.size()))
+            return -1;
+        if (keys[i] == keys[j])
+            return 64 + __builtin_clz(uint32_t(i) ^ uint32_t(j));
+        return __builtin_clzll(keys[i] ^ keys[j]);
+    }
+
+    static void karras_split(const std::vector<uint64_t>& keys, int i, int& left, int& right)
+    {
+        // Finds the range of keys that interior node i covers and where that range splits.
+        // Children are interior node indices, or ~j for leaf j.
+        int d = common_prefix(keys, i, i + 1) > common_prefix(keys, i, i - 1) ? 1 : -1;
+
+        // The range extends from i in direction d for as long as the keys share more than
+        // the prefix i shares with its neighbour on the other side.
+        int min_prefix = common_prefix(keys, i, i - d);
+        int max_length = 2;
+        while (common_prefix(keys, i, i + max_length * d) > min_prefix)
+            max_length *= 2;
+
+        int length = 0;
+        for (int step = max_length / 2; step >= 1; step /= 2)
+        {
+            if (common_prefix(keys, i, i + (length + step) * d) > min_prefix)
+                length += step;
+        }
+        int j = i + length * d;
+
+        // The split is where the range's common prefix grows by a bit.
+        int node_prefix = common_prefix(keys, i, j);
+        int offset = 0;
+        for (int divisor = 2;; divisor *= 2)
+        {
+            int step = (length + divisor - 1) / divisor;
+            if (common_prefix(keys, i, i + (offset + step) * d) > node_prefix)
+                offset += step;
+            if (step <= 1)
+                break;
+        }
+        int gamma = i + offset * d + std::min(d, 0);
+
+        left = std::min(i, j) == gamma ? ~gamma : gamma;
+        right = std::max(i, j) == gamma + 1 ? ~(gamma + 1) : gamma + 1;
+    }
+
+    static aabb intersect(const aabb& a, const aabb& b)
+    {
+        return aabb(interval(std::max(a.x.min, b.x.min), std::min(a.x.max, b.x.max)),
+                    interval(std::max(a.y.min, b.y.min), std::min(a.y.max, b.y.max)),
+                    interval(std::max(a.z.min, b.z.min), std::min(a.z.max, b.z.max)));
+    }
+
+    int build_median(const std::vector<aabb>& boxes, size_t start, size_t end, int max_leaf_size)
+    {
+        int index = int(nodes.size());
+        nodes.emplace_back();
+
+        aabb bounds = aabb::empty;
+        for (size_t i = start; i < end; i++)
+            bounds = aabb(bounds, boxes[refs[i]]);
+        nodes[index].bounds = bounds;
+
+        if (end - start <= size_t(max_leaf_size))
+        {
+            nodes[index].first = int(start);
+            nodes[index].count = int(end - start);
+            return index;
+        }
+
+        int axis = bounds.longest_axis();
+        std::sort(refs.begin() + start, refs.begin() + end,
+                  [&](int a, int b)
+                  {
+                      return boxes[a].axis_interval(axis).min < boxes[b].axis_interval(axis).min;
+                  });
+
+        auto mid = start + (end - start) / 2;
+        int left = build_median(boxes, start, mid, max_leaf_size);
+        int right = build_median(boxes, mid, end, max_leaf_size);
+        nodes[index].left = left;
+        nodes[index].right = right;
+        return index;
+    }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,418 @@
+#include "rtweekend.h"
+
+#include "scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Reports the quality of the BVHs that the builders produce for a scene: the shape of the
+// tree, the surface area heuristic's cost estimate, the overlap between siblings, memory, how
+// many nodes a sample of the scene's own rays visits, and how much faster its shadow rays are
+// answered by occluded() than by a closest hit search. Optionally writes the node boxes as an
+// OBJ wireframe for viewing. Every figure is printed as one `key: value` line, so that
+// benchmark scripts can compare runs and flag regressions.
+
+struct recorded_ray
+{
+    ray r;
+    interval ray_t;
+    bool any_hit; // Shadow ray: any hit ends the search
+};
+
+class ray_recorder : public hittable
+{
+  public:
+    // Traces through `world` and keeps a copy of every query, to replay against other trees.
+    // Not thread-safe: trace through it from one thread.
+
+    mutable std::vector<recorded_ray> rays;
+
+    ray_recorder(const hittable& world) : world(world) {}
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override
+    {
+        rays.push_back({r, ray_t, false});
+        return world.hit(r, ray_t, rec);
+    }
+
+    bool occluded(const ray& r, interval ray_t) const override
+    {
+        rays.push_back({r, ray_t, true});
+        return world.occluded(r, ray_t);
+    }
+
+    aabb bounding_box() const override { return world.bounding_box(); }
+
+  private:
+    const hittable& world;
+};
+
+struct builder
+{
+    std::string name;
+    std::function<bvh_build(const std::vector<aabb>& boxes, const bvh_build::clip_function& clip)>
+        build;
+};
+
+std::string histogram(const std::map<int, size_t>& counts)
+{
+    std::string text;
+    for (const auto& [value, count] : counts)
+        text += (text.empty() ? "" : " ") + std::to_string(value) + ':' + std::to_string(count);
+    return text;
+}
+
+template <typename replay_function> double best_seconds(replay_function replay)
+{
+    // Times a few uncounted replays; the fastest is the least disturbed by other work.
+    double best = 0;
+    for (int repeat = 0; repeat < 5; repeat++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        replay();
+        auto end = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        best = repeat == 0 ? seconds : std::min(best, seconds);
+    }
+    return best;
+}
+
+void report_any_hit(const std::string& prefix, const hittable& world,
+                    const std::vector<recorded_ray>& rays)
+{
+    // Times the shadow rays answered by occluded(), then the same rays answered by a closest
+    // hit search, as they were before the any-hit path. Both must find the same rays blocked.
+    // Scenes without lights cast no shadow rays and have nothing to report.
+    if (std::none_of(rays.begin(), rays.end(), [](const recorded_ray& q) { return q.any_hit; }))
+        return;
+
+    size_t count = 0, blocked = 0, blocked_closest = 0;
+    double any_s = best_seconds(
+        [&]
+        {
+            count = blocked = 0;
+            for (const auto& q : rays)
+            {
+                if (q.any_hit)
+                {
+                    count++;
+                    blocked += world.occluded(q.r, q.ray_t);
+                }
+            }
+        });
+    double closest_s = best_seconds(
+        [&]
+        {
+            blocked_closest = 0;
+            for (const auto& q : rays)
+            {
+                hit_record rec;
+                if (q.any_hit)
+                    blocked_closest += world.hit(q.r, q.ray_t, rec);
+            }
+        });
+
+    auto mrays = [&](double seconds) { return seconds > 0 ? count / seconds / 1e6 : 0.0; };
+    std::printf("%sany_hit_blocked: %zu\n", prefix.c_str(), blocked);
+    std::printf("%sany_hit_blocked_by_closest_hit: %zu\n", prefix.c_str(), blocked_closest);
+    std::printf("%sany_hit_mrays_per_second: %.3f\n", prefix.c_str(), mrays(any_s));
+    std::printf("%sany_hit_as_closest_mrays_per_second: %.3f\n", prefix.c_str(),
+                mrays(closest_s));
+    std::printf("%sany_hit_speedup: %.2f\n", prefix.c_str(),
+                any_s > 0 ? closest_s / any_s : 0.0);
+}
+
+void report(const builder& b, const std::vector<shared_ptr<hittable>>& objects,
+            const std::vector<aabb>& boxes, const bvh_build::clip_function& clip,
+            const std::vector<recorded_ray>& rays, const std::string& obj_path, int obj_depth)
+{
+    auto start_time = std::chrono::high_resolution_clock::now();
+    bvh_build tree = b.build(boxes, clip);
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    // Depth of every leaf, the root being at depth 0, and the primitives in each.
+    std::map<int, size_t> depths, leaf_sizes;
+    size_t leaves = 0;
+    double depth_sum = 0;
+    std::vector<std::pair<int, int>> pending = {{0, 0}};
+    while (!pending.empty())
+    {
+        auto [index, depth] = pending.back();
+        pending.pop_back();
+        const auto& n = tree.nodes[index];
+        if (n.is_leaf())
+        {
+            depths[depth]++;
+            leaf_sizes[n.count]++;
+            leaves++;
+            depth_sum += depth;
+            continue;
+        }
+        pending.push_back({n.left, depth + 1});
+        pending.push_back({n.right, depth + 1});
+    }
+
+    compact_bvh bvh(objects, tree);
+
+    // Replay the sampled rays, counting the nodes they visit.
+    std::vector<uint32_t> visits(bvh.node_count());
+    size_t any_hit_rays = 0;
+    uint64_t closest_visits = 0, any_visits = 0, any_as_closest_visits = 0;
+    for (const auto& q : rays)
+    {
+        if (q.any_hit)
+        {
+            any_hit_rays++;
+            bvh.occluded(q.r, q.ray_t, visits.data());
+        }
+    }
+    for (auto v : visits)
+        any_visits += v;
+    std::fill(visits.begin(), visits.end(), 0);
+    for (const auto& q : rays)
+    {
+        hit_record rec;
+        if (!q.any_hit)
+            bvh.hit(q.r, q.ray_t, rec, visits.data());
+    }
+    for (auto v : visits)
+        closest_visits += v;
+    std::fill(visits.begin(), visits.end(), 0);
+    for (const auto& q : rays)
+    {
+        hit_record rec;
+        if (q.any_hit)
+            bvh.hit(q.r, q.ray_t, rec, visits.data());
+    }
+    for (auto v : visits)
+        any_as_closest_visits += v;
+
+    double trace_s = best_seconds(
+        [&]
+        {
+            for (const auto& q : rays)
+            {
+                hit_record rec;
+                if (q.any_hit)
+                    bvh.occluded(q.r, q.ray_t);
+                else
+                    bvh.hit(q.r, q.ray_t, rec);
+            }
+        });
+
+    size_t closest_rays = rays.size() - any_hit_rays;
+    auto per = [](double total, size_t count) { return count > 0 ? total / count : 0.0; };
+    double build_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+
+    std::printf("builder: %s\n", b.name.c_str());
+    std::printf("build_ms: %.1f\n", build_ms);
+    std::printf("nodes: %zu\n", tree.nodes.size());
+    std::printf("leaves: %zu\n", leaves);
+    std::printf("references_per_primitive: %.4f\n", per(double(tree.refs.size()), boxes.size()));
+    std::printf("leaf_depth_min: %d\n", depths.empty() ? 0 : depths.begin()->first);
+    std::printf("leaf_depth_mean: %.2f\n", per(depth_sum, leaves));
+    std::printf("leaf_depth_max: %d\n", depths.empty() ? 0 : depths.rbegin()->first);
+    std::printf("leaf_depth_histogram: %s\n", histogram(depths).c_str());
+    std::printf("leaf_size_histogram: %s\n", histogram(leaf_sizes).c_str());
+    std::printf("sah_cost: %.3f\n", tree.sah_cost());
+    std::printf("overlap: %.6f\n", tree.overlap());
+    std::printf("build_bytes: %zu\n",
+                tree.nodes.size() * sizeof(bvh_build::node) + tree.refs.size() * sizeof(int));
+    std::printf("compact_nodes: %zu\n", bvh.node_count());
+    std::printf("compact_bytes: %zu\n", bvh.memory_bytes());
+    std::printf("closest_hit_rays: %zu\n", closest_rays);
+    std::printf("closest_hit_nodes_per_ray: %.2f\n", per(double(closest_visits), closest_rays));
+    std::printf("any_hit_rays: %zu\n", any_hit_rays);
+    std::printf("any_hit_nodes_per_ray: %.2f\n", per(double(any_visits), any_hit_rays));
+    std::printf("any_hit_as_closest_nodes_per_ray: %.2f\n",
+                per(double(any_as_closest_visits), any_hit_rays));
+    std::printf("mrays_per_second: %.3f\n", trace_s > 0 ? rays.size() / trace_s / 1e6 : 0.0);
+    report_any_hit("", bvh, rays);
+    std::printf("\n");
+
+    if (!obj_path.empty())
+    {
+        // One group of box outlines per depth, down to obj_depth.
+        std::ofstream out(obj_path);
+        out << "# " << b.name << " BVH, depths 0 to " << obj_depth << '\n';
+        size_t vertex = 1;
+        std::vector<std::pair<int, int>> level = {{0, 0}};
+        for (int depth = 0; depth <= obj_depth && !level.empty(); depth++)
+        {
+            out << "g depth_" << depth << '\n';
+            std::vector<std::pair<int, int>> next;
+            for (auto [index, d] : level)
+            {
+                const auto& n = tree.nodes[index];
+                for (int corner = 0; corner < 8; corner++)
+                {
+                    out << "v " << (corner & 1 ? n.bounds.x.max : n.bounds.x.min) << ' '
+                        << (corner & 2 ? n.bounds.y.max : n.bounds.y.min) << ' '
+                        << (corner & 4 ? n.bounds.z.max : n.bounds.z.min) << '\n';
+                }
+                // The twelve edges join corners that differ in one coordinate bit.
+                for (int corner = 0; corner < 8; corner++)
+                {
+                    for (int bit = 1; bit < 8; bit <<= 1)
+                    {
+                        if (!(corner & bit))
+                            out << "l " << vertex + corner << ' ' << vertex + (corner | bit)
+                                << '\n';
+                    }
+                }
+                vertex += 8;
+
+                if (!n.is_leaf())
+                {
+                    next.push_back({n.left, d + 1});
+                    next.push_back({n.right, d + 1});
+                }
+            }
+            level = std::move(next);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    render_config config;
+    std::string builder_name = "all", obj_path;
+    int obj_depth = 6, ray_width = 64, visibility_rays = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        auto arg = std::string(argv[i]);
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--scene" && has_value)
+            config.scene_id = std::atoi(argv[++i]);
+        else if (arg == "--primitives" && has_value)
+            config.primitive_count = std::atoi(argv[++i]);
+        else if (arg == "--builder" && has_value)
+            builder_name = argv[++i];
+        else if (arg == "--ray-width" && has_value)
+            ray_width = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--visibility-rays" && has_value)
+            visibility_rays = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--obj" && has_value)
+            obj_path = argv[++i];
+        else if (arg == "--obj-depth" && has_value)
+            obj_depth = std::max(0, std::atoi(argv[++i]));
+        else
+        {
+            std::cerr
+                << "Usage: bvh_stats [options]\n"
+                   "  --scene <n>        Scene to build, as for cpu_pt (default 1)\n"
+                   "  --primitives <n>   Sphere or quad field: number of primitives\n"
+                   "  --builder <name>   median, sah, sbvh, lbvh, lbvh-sah or all (default)\n"
+                   "  --ray-width <px>   Width of the sample render whose rays are replayed\n"
+                   "                     against each tree (default 64, 1 sample per pixel)\n"
+                   "  --visibility-rays <n>  Also replay n shadow rays between random points\n"
+                   "                     in the scene's box (default 0)\n"
+                   "  --obj <file>       Write the first builder's node boxes as OBJ lines\n"
+                   "  --obj-depth <d>    Deepest level written to the OBJ file (default 6)\n";
+            return 1;
+        }
+    }
+
+    // The scene's primitives without an acceleration structure; the large ones that
+    // build_accelerator() keeps out of the BVH are left out here too.
+    config.accel = int32_t(accel_type::none);
+    scene s = build_scene(config);
+    hittable_list bounded, large;
+    split_large_primitives(s.world, bounded, large);
+    const auto& objects = bounded.objects;
+    if (objects.empty())
+    {
+        std::cerr << "bvh_stats: the scene has no primitives to build a BVH over\n";
+        return 1;
+    }
+
+    std::vector<aabb> boxes;
+    for (const auto& object : objects)
+        boxes.push_back(object->bounding_box());
+    auto clip = [&](int index, const aabb& region) { return objects[index]->clipped_box(region); };
+
+    // Sample rays: the closest-hit and shadow queries of a small render of the scene's view,
+    // traced through the world as cpu_pt would build it.
+    std::vector<recorded_ray> rays;
+    {
+        arena mem;
+        hittable_list world = build_accelerator(s.world, mem, accel_type::compact);
+        ray_recorder recorder(world);
+        camera cam = s.cam;
+        cam.image_width = ray_width;
+        cam.initialize();
+        std::vector<color> sums(size_t(cam.image_width) * cam.get_image_height());
+        cam.render_tile(recorder, s.lights, tile(0, 0, cam.image_width, cam.get_image_height()),
+                        0, 1, sums.data());
+        rays = std::move(recorder.rays);
+    }
+
+    // Visibility queries between random points of the scene's box, for scenes with few
+    // shadow rays of their own.
+    aabb bounds = bounded.bounding_box();
+    std::mt19937_64 rng(11);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    auto random_point = [&]
+    {
+        return point3(bounds.x.min + uniform(rng) * bounds.x.size(),
+                      bounds.y.min + uniform(rng) * bounds.y.size(),
+                      bounds.z.min + uniform(rng) * bounds.z.size());
+    };
+    for (int n = 0; n < visibility_rays; n++)
+    {
+        point3 from = random_point(), to = random_point();
+        rays.push_back({ray(from, to - from), interval(0, 1), true});
+    }
+
+    std::vector<builder> builders = {
+        {"median", [](const auto& boxes, const auto&) { return bvh_build::median_split(boxes); }},
+        {"sah",
+         [](const auto& boxes, const auto& clip)
+         { return bvh_build::spatial_split(boxes, clip, 0.0); }},
+        {"sbvh",
+         [](const auto& boxes, const auto& clip)
+         { return bvh_build::spatial_split(boxes, clip); }},
+        {"lbvh", [](const auto& boxes, const auto&) { return bvh_build::morton(boxes); }},
+        {"lbvh-sah",
+         [](const auto& boxes, const auto&) { return bvh_build::morton(boxes, 63, true); }},
+    };
+
+    std::printf("primitives: %zu\n", objects.size());
+    std::printf("primitives_outside_bvh: %zu\n", large.objects.size());
+    std::printf("sample_rays: %zu\n", rays.size());
+    {
+        // The pointer-based bvh_node that `--accel bvh` renders with, for comparison with the
+        // compact forms below; its topology is that of the median builder. Arena blocks are
+        // counted whole, so small scenes read high.
+        arena mem;
+        auto root = build_bvh(bounded, mem, accel_type::bvh);
+        std::printf("bvh_node_reserved_bytes: %zu\n", mem.bytes_reserved());
+        report_any_hit("bvh_node_", *root, rays);
+        std::printf("\n");
+    }
+
+    bool found = false;
+    for (const auto& b : builders)
+    {
+        if (builder_name != "all" && builder_name != b.name)
+            continue;
+        report(b, objects, boxes, clip, rays, found ? "" : obj_path, obj_depth);
+        found = true;
+    }
+
+    if (!found)
+    {
+        std::cerr << "bvh_stats: unknown builder " << builder_name << '\n';
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -2,9 +2,43 @@
 #define CAMERA_H
 
 #include "hittable.h"
+#include "light.h"
 #include "material.h"
+#include "ray_sort.h"
+#include "sampler.h"
 
+#include <algorithm>
 #include <execution>
+#include <vector>
+
+class tile
+{
+  public:
+    // A rectangle of pixels [x0, x1) x [y0, y1).
+    int x0, y0, x1, y1;
+
+    tile() : x0(0), y0(0), x1(0), y1(0) {}
+
+    tile(int x0, int y0, int x1, int y1) : x0(x0), y0(y0), x1(x1), y1(y1) {}
+
+    int width() const { return x1 - x0; }
+    int height() const { return y1 - y0; }
+    int pixel_count() const { return width() * height(); }
+};
+
+inline std::vector<tile> split_into_tiles(int image_width, int image_height, int tile_size)
+{
+    std::vector<tile> tiles;
+    for (int y = 0; y < image_height; y += tile_size)
+    {
+        for (int x = 0; x < image_width; x += tile_size)
+        {
+            tiles.emplace_back(x, y, std::min(x + tile_size, image_width),
+                               std::min(y + tile_size, image_height));
+        }
+    }
+    return tiles;
+}
 
 class camera
 {
@@ -22,73 +56,90 @@ class camera
     double defocus_angle = 0; // Variation angle of rays through each pixel
     double focus_dist = 10;   // Distance from camera lookfrom point to plane of perfect focus
 
-    void render(const hittable& world)
+    double shutter_open = 0;  // Ray times are spread over [shutter_open, shutter_close], a
+    double shutter_close = 0; // part of the frame interval [0, 1]; equal values freeze motion
+
+    sampler_type sampler_kind = sampler_type::independent; // Sequence used for pixel samples
+    int seed = 0; // Renders with the same seed and sampler are reproducible
+
+    bool sky_background = true;         // Use the sky gradient for rays that escape the scene
+    color background = color(0, 0, 0); // Scene background color when the sky is disabled
+
+    int ray_batch = 0; // Path samples traced together, bounce by bounce with sorted rays; 0
+                       // traces each sample to the end before starting the next
+
+    void render(const hittable& world) { render(world, light_list()); }
+
+    void render(const hittable& world, const light_list& lights)
     {
         initialize();
 
         std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
 
+        std::fill(frameBuffer.begin(), frameBuffer.end(), color(0, 0, 0));
+
 #define MT 1
 #if MT
         std::for_each(std::execution::par, image_height_itr.begin(), image_height_itr.end(),
-                      [this, &world](int j)
+                      [this, &world, &lights](int j)
                       {
                           std::clog << "\rScanlines remaining: " << (image_height - j) << ' '
                                     << std::flush;
-                          for (int i = 0; i < image_width; i++)
-                          {
-                              color pixel_color(0, 0, 0);
-                              for (int sample = 0; sample < samples_per_pixel; sample++)
-                              {
-                                  ray r = get_ray(i, j);
-                                  pixel_color += ray_color(r, max_depth, world);
-                              }
-                              frameBuffer[j * image_width + i] = pixel_samples_scale * pixel_color;
-                          }
+                          render_tile(world, lights, tile(0, j, image_width, j + 1), 0,
+                                      samples_per_pixel, &frameBuffer[j * image_width]);
                       });
+#else
+        for (int j = 0; j < image_height; j++)
+        {
+            std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;
+            render_tile(world, lights, tile(0, j, image_width, j + 1), 0, samples_per_pixel,
+                        &frameBuffer[j * image_width]);
+        }
+        std::clog << "\rDone.                 \n";
+#endif
 
         for (int j = 0; j < image_height; j++)
         {
             for (int i = 0; i < image_width; i++)
             {
-                write_color(std::cout, frameBuffer[j * image_width + i]);
+                write_color(std::cout, pixel_samples_scale * frameBuffer[j * image_width + i]);
             }
         }
+    }
 
-#else
-        for (int j = 0; j < image_height; j++)
+    void render_tile(const hittable& world, const light_list& lights, const tile& t,
+                     int sample_begin, int sample_end, color* sums) const
+    {
+        // Adds the radiance of samples [sample_begin, sample_end) of every pixel in `t` to
+        // `sums`, a row-major array covering the tile. The sums are left unnormalized so that
+        // tiles and sample ranges rendered separately, even in other processes, add up to the
+        // same image. Requires initialize().
+        if (ray_batch > 0)
         {
-            std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;
-            for (int i = 0; i < image_width; i++)
+            render_tile_sorted(world, lights, t, sample_begin, sample_end, sums);
+            return;
+        }
+
+        auto smp = make_sampler(sampler_kind, samples_per_pixel, seed);
+        for (int j = t.y0; j < t.y1; j++)
+        {
+            for (int i = t.x0; i < t.x1; i++)
             {
-                color pixel_color(0, 0, 0);
-                for (int sample = 0; sample < samples_per_pixel; sample++)
+                auto& pixel_color = sums[(j - t.y0) * t.width() + (i - t.x0)];
+                for (int sample = sample_begin; sample < sample_end; sample++)
                 {
-                    ray r = get_ray(i, j);
-                    pixel_color += ray_color(r, max_depth, world);
+                    smp->start_pixel_sample(i, j, sample);
+                    ray r = get_ray(i, j, *smp);
+                    pixel_color += ray_color(r, max_depth, world, lights, *smp);
                 }
-                write_color(std::cout, pixel_samples_scale * pixel_color);
             }
         }
-        std::clog << "\rDone.                 \n";
-#endif
     }
 
-  private:
-    int image_height;
-    double pixel_samples_scale;
-    point3 center;
-    point3 pixel00_loc;
-    vec3 pixel_delta_u;
-    vec3 pixel_delta_v;
-    vec3 u, v, w; // Camera frame basis vectors
-    vec3 defocus_disk_u;
-    vec3 defocus_disk_v;
-    std::vector<int> image_height_itr;
-    std::vector<color> frameBuffer;
-
     void initialize()
     {
+        // Derives the image size and viewing frame from the public parameters. render() calls
+        // this itself; callers of render_tile() call it once after setting the parameters.
         image_height = int(image_width / aspect_ratio);
         image_height = (image_height < 1) ? 1 : image_height;
 
@@ -131,51 +182,245 @@ class camera
         defocus_disk_v = v * defocus_radius;
     }
 
-    ray get_ray(int i, int j) const
+    int get_image_height() const { return image_height; }
+
+  private:
+    int image_height;
+    double pixel_samples_scale;
+    point3 center;
+    point3 pixel00_loc;
+    vec3 pixel_delta_u;
+    vec3 pixel_delta_v;
+    vec3 u, v, w; // Camera frame basis vectors
+    vec3 defocus_disk_u;
+    vec3 defocus_disk_v;
+    std::vector<int> image_height_itr;
+    std::vector<color> frameBuffer;
+
+    ray get_ray(int i, int j, sampler& smp) const
     {
         // Construct a camera ray originating from the defocus disk and directed at randomly
         // sampled point around the pixel location i, j.
 
-        auto offset = sample_square();
+        auto offset = sample_square(smp);
         auto pixel_sample =
             pixel00_loc + ((i + offset.x()) * pixel_delta_u) + ((j + offset.y()) * pixel_delta_v);
 
-        auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample();
+        // The lens dimensions are always consumed so the material dimensions line up between
+        // pinhole and thin-lens cameras.
+        auto lens = smp.get_2d();
+        auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample(lens);
         auto ray_direction = pixel_sample - ray_origin;
 
-        return ray(ray_origin, ray_direction);
+        // Only an open shutter draws a time, so frames without motion blur keep the sample
+        // dimensions, and so the images, they had before it existed.
+        auto ray_time = shutter_open;
+        if (shutter_close > shutter_open)
+            ray_time += smp.get_1d() * (shutter_close - shutter_open);
+
+        return ray(ray_origin, ray_direction, ray_time);
     }
 
-    vec3 sample_square() const
+    vec3 sample_square(sampler& smp) const
     {
         // Returns the vector to a random point in the [-.5,-.5]-[+.5,+.5] unit square.
-        return vec3(random_double() - 0.5, random_double() - 0.5, 0);
+        auto u = smp.get_2d();
+        return vec3(u[0] - 0.5, u[1] - 0.5, 0);
     }
 
-    point3 defocus_disk_sample() const
+    point3 defocus_disk_sample(const vec3& u) const
     {
         // Returns a random point in the camera defocus disk.
-        auto p = random_in_unit_disk();
+        auto p = sample_uniform_disk_concentric(u[0], u[1]);
         return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
     }
 
-    color ray_color(const ray& r, int depth, const hittable& world) const
+    color ray_color(const ray& r, int depth, const hittable& world, const light_list& lights,
+                    sampler& smp) const
+    {
+        // Traces the path that starts with `r` for up to `depth` bounces, one extend_path()
+        // step at a time, and returns the radiance it gathers.
+        path_state path{r, color(1, 1, 1), 0, vec3(), depth, 0, &smp};
+        color radiance(0, 0, 0);
+        while (extend_path(path, world, lights, radiance))
+            continue;
+        return radiance;
+    }
+
+    struct path_state
+    {
+        ray r;
+        color throughput; // Product of the attenuations of the bounces so far
+        double bsdf_pdf;  // Density with which the previous bounce sampled `r`, or zero when
+                          // that bounce was specular (or `r` is a camera ray) and emission
+                          // must be counted fully
+        vec3 prev_normal; // Surface normal at that bounce, which light selection depends on
+        int depth;        // Bounces left
+        int pixel;        // Index into the tile's sums, for render_tile_sorted()
+        sampler* smp;     // The sample's own sequence, which it draws from at every bounce
+    };
+
+    void render_tile_sorted(const hittable& world, const light_list& lights, const tile& t,
+                            int sample_begin, int sample_end, color* sums) const
     {
+        // render_tile() for batches of ray_batch path samples. Every path of a batch takes its
+        // next bounce before any takes the one after, and from the second bounce on, the rays
+        // are traced in ray_sort_key() order. Each sample keeps its own sampler, so it draws
+        // the same numbers as when traced alone; the image differs only in rounding, since
+        // each bounce adds its weighted radiance to the pixel's sum instead of to the sample's.
+        int sample_count = sample_end - sample_begin;
+        size_t total = size_t(t.pixel_count()) * std::max(sample_count, 0);
+        size_t batch_size = std::min(size_t(ray_batch), total);
+
+        std::vector<std::unique_ptr<sampler>> samplers(batch_size);
+        for (auto& smp : samplers)
+            smp = make_sampler(sampler_kind, samples_per_pixel, seed);
+
+        std::vector<path_state> paths, sorted;
+        std::vector<uint32_t> keys;
+        std::vector<int> order;
+        paths.reserve(batch_size);
+        sorted.reserve(batch_size);
+
+        for (size_t first = 0; first < total; first += batch_size)
+        {
+            // Samples are numbered pixel by pixel, so a batch covers whole pixels when it can.
+            paths.clear();
+            for (size_t id = first; id < std::min(first + batch_size, total); id++)
+            {
+                int pixel = int(id / sample_count);
+                int i = t.x0 + pixel % t.width(), j = t.y0 + pixel / t.width();
+                sampler* smp = samplers[id - first].get();
+                smp->start_pixel_sample(i, j, sample_begin + int(id % sample_count));
+                paths.push_back({get_ray(i, j, *smp), color(1, 1, 1), 0, vec3(), max_depth,
+                                 pixel, smp});
+            }
+
+            // Camera rays leave in pixel order, which is already coherent.
+            bool camera_rays = true;
+            while (!paths.empty())
+            {
+                if (!camera_rays)
+                {
+                    aabb origins = aabb::empty;
+                    for (const auto& path : paths)
+                        origins = aabb(origins, aabb(path.r.origin(), path.r.origin()));
+
+                    keys.resize(paths.size());
+                    order.resize(paths.size());
+                    for (size_t k = 0; k < paths.size(); k++)
+                    {
+                        keys[k] = ray_sort_key(paths[k].r, origins);
+                        order[k] = int(k);
+                    }
+                    sort_by_key(keys, order);
+
+                    sorted.clear();
+                    for (int k : order)
+                        sorted.push_back(paths[k]);
+                    paths.swap(sorted);
+                }
+                camera_rays = false;
+
+                // Trace the bounce, keeping the paths that continue in the same order.
+                size_t alive = 0;
+                for (auto& path : paths)
+                {
+                    if (extend_path(path, world, lights, sums[path.pixel]))
+                        paths[alive++] = path;
+                }
+                paths.resize(alive);
+            }
+        }
+    }
+
+    bool extend_path(path_state& path, const hittable& world, const light_list& lights,
+                     color& radiance) const
+    {
+        // One bounce of `path`: adds the light it gathers there, weighted by the path's
+        // throughput, to `radiance`, and returns whether the path continues. Both render
+        // modes trace every path through this one step.
+
         // If we've exceeded the ray bounce limit, no more light is gathered.
-        if (depth <= 0)
-            return color(0, 0, 0);
+        if (path.depth <= 0)
+            return false;
 
+        const ray& r = path.r;
         hit_record rec;
 
-        if (world.hit(r, interval(0.001, infinity), rec))
+        if (!world.hit(r, interval(0, infinity), rec))
         {
-            ray scattered;
-            color attenuation;
-            if (rec.mat->scatter(r, rec, attenuation, scattered))
-                return attenuation * ray_color(scattered, depth - 1, world);
-            return color(0, 0, 0);
+            radiance += path.throughput * (sky_background ? sky_color(r) : background);
+            return false;
+        }
+
+        // Emission found by BSDF sampling, weighted against the chance that next-event
+        // estimation at the previous vertex already picked this light.
+        color color_from_emission = rec.mat->emitted(r, rec);
+        if (path.bsdf_pdf > 0 && !lights.empty())
+        {
+            auto light_pdf =
+                lights.pmf(r.origin(), path.prev_normal, rec.object) *
+                rec.object->pdf_value(r.origin(), r.direction());
+            color_from_emission = power_heuristic(path.bsdf_pdf, light_pdf) * color_from_emission;
         }
 
+        color color_from_lights = sample_lights(r, rec, world, lights, *path.smp);
+        radiance += path.throughput * (color_from_emission + color_from_lights);
+
+        ray scattered;
+        color attenuation;
+        if (!rec.mat->scatter(r, rec, attenuation, scattered, *path.smp))
+            return false;
+
+        path.bsdf_pdf = rec.mat->scattering_pdf(r, rec, scattered.direction());
+        path.prev_normal = rec.normal;
+        path.throughput = path.throughput * attenuation;
+        path.r = scattered;
+        path.depth--;
+        return true;
+    }
+
+    color sample_lights(const ray& r, const hit_record& rec, const hittable& world,
+                        const light_list& lights, sampler& smp) const
+    {
+        // Next-event estimation: pick a light, sample a direction toward it and trace a shadow
+        // ray, weighting the result against BSDF sampling with the power heuristic.
+        if (lights.empty())
+            return color(0, 0, 0);
+
+        double pmf;
+        const hittable* light = lights.sample(rec.p, rec.normal, smp.get_1d(), pmf);
+        auto u = smp.get_2d();
+        if (!light)
+            return color(0, 0, 0);
+
+        auto wi = light->random(rec.p, u);
+        auto light_pdf = pmf * light->pdf_value(rec.p, wi);
+        if (light_pdf <= 0)
+            return color(0, 0, 0);
+
+        color f = rec.mat->eval(r, rec, wi);
+        if (f.near_zero())
+            return color(0, 0, 0);
+
+        // Find where the shadow ray meets the light, then only ask whether anything blocks
+        // the segment in front of it.
+        ray shadow_ray = rec.spawn_ray(wi, r.time());
+        hit_record light_rec;
+        if (!light->hit(shadow_ray, interval(0, infinity), light_rec))
+            return color(0, 0, 0);
+
+        if (world.occluded(shadow_ray, interval(0, light_rec.t * (1 - 1e-9))))
+            return color(0, 0, 0);
+
+        color emitted = light_rec.mat->emitted(shadow_ray, light_rec);
+        auto weight = power_heuristic(light_pdf, rec.mat->scattering_pdf(r, rec, wi));
+        return (weight / light_pdf) * f * emitted;
+    }
+
+    color sky_color(const ray& r) const
+    {
         vec3 unit_direction = unit_vector(r.direction());
         auto a = 0.5 * (unit_direction.y() + 1.0);
         return (1.0 - a) * color(1.0, 1.0, 1.0) + a * color(0.5, 0.7, 1.0);
@@ -0,0 +1,558 @@
+#ifndef COMPACT_BVH_H
+#define COMPACT_BVH_H
+
+// A flattened 4-wide BVH whose nodes each fill one 64-byte cache line. Child boxes are stored
+// as 8-bit offsets on a per-axis power-of-two grid anchored at the node's lower corner and
+// rounded outwards, so a decoded box always contains the exact one. Decoding happens during
+// traversal: the grid origin is a float and the scale a power of two, so origin + q * scale
+// is exact in double precision.
+
+#include "bvh_build.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "traversal_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <utility>
+#include <vector>
+
+template <typename T> struct page_allocator
+{
+    // Allocates on 4 KB page boundaries, so that every page-sized run of elements from the
+    // start of a vector occupies exactly one page.
+    using value_type = T;
+    static constexpr size_t page_size = 4096;
+
+    page_allocator() = default;
+    template <typename U> page_allocator(const page_allocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(page_size)));
+    }
+
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(page_size)); }
+
+    template <typename U> bool operator==(const page_allocator<U>&) const { return true; }
+    template <typename U> bool operator!=(const page_allocator<U>&) const { return false; }
+};
+
+class compact_bvh : public hittable
+{
+  public:
+    static constexpr int width = 4;
+
+    compact_bvh(const hittable_list& list) : compact_bvh(list.objects) {}
+
+    compact_bvh(const std::vector<shared_ptr<hittable>>& objects)
+    {
+        std::vector<aabb> boxes;
+        boxes.reserve(objects.size());
+        for (const auto& object : objects)
+            boxes.push_back(object->bounding_box());
+
+        build(objects, bvh_build::median_split(boxes));
+    }
+
+    compact_bvh(const std::vector<shared_ptr<hittable>>& objects, const bvh_build& b)
+    {
+        build(objects, b);
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override
+    {
+        return find_hit(r, ray_t, rec, [](uint32_t) {});
+    }
+
+    bool occluded(const ray& r, interval ray_t) const override
+    {
+        return find_any(r, ray_t, [](uint32_t) {});
+    }
+
+    // Traversals that also add one to visits[i] for every node i they visit. `visits` must
+    // have node_count() entries.
+    bool hit(const ray& r, interval ray_t, hit_record& rec, uint32_t* visits) const
+    {
+        return find_hit(r, ray_t, rec, [visits](uint32_t i) { visits[i]++; });
+    }
+
+    bool occluded(const ray& r, interval ray_t, uint32_t* visits) const
+    {
+        return find_any(r, ray_t, [visits](uint32_t i) { visits[i]++; });
+    }
+
+    // Traversals that call on_visit(i) for every node i in the order they visit them, for
+    // tools that model the memory accesses of traversal.
+    template <typename visit_function>
+    bool hit(const ray& r, interval ray_t, hit_record& rec, visit_function on_visit) const
+    {
+        return find_hit(r, ray_t, rec, on_visit);
+    }
+
+    template <typename visit_function>
+    bool occluded(const ray& r, interval ray_t, visit_function on_visit) const
+    {
+        return find_any(r, ray_t, on_visit);
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    size_t node_count() const { return nodes.size(); }
+
+    // Where node i lives; each node fills one 64-byte cache line.
+    const void* node_address(uint32_t i) const { return &nodes[i]; }
+
+    size_t memory_bytes() const
+    {
+        // Bytes of the traversal data: nodes plus the primitive reference array.
+        return nodes.size() * sizeof(node) + primitives.size() * sizeof(const hittable*);
+    }
+
+    std::vector<double> area_weights() const
+    {
+        // The surface area of every node's box. For rays spread uniformly over the scene, the
+        // chance that a ray visits a node grows with its surface area, so these serve as visit
+        // frequencies when no measured ones are at hand.
+        std::vector<double> weights(nodes.size());
+        if (nodes.empty())
+            return weights;
+
+        weights[0] = bvh_build::surface_area(bbox);
+        for (const auto& n : nodes)
+        {
+            for (int c = 0; c < n.child_count; c++)
+            {
+                if (n.leaf_size[c] == 0)
+                    weights[n.child[c]] = bvh_build::surface_area(n.child_box(c));
+            }
+        }
+        return weights;
+    }
+
+    void reorder(const std::vector<double>& weights, size_t treelet_nodes = 64)
+    {
+        // Lays the nodes out as treelets of `treelet_nodes` nodes, 4 KB, one page, with the
+        // default. Each treelet grows from its root by repeatedly taking the heaviest node
+        // reachable from it, where weights[i] estimates how often node i is visited, so the
+        // paths most rays follow cross few pages. Within a treelet the nodes keep their
+        // depth-first order. The nodes left on the frontier of a full treelet root the next
+        // treelets, heaviest first. Full treelets come first, so that with the page-aligned
+        // node array each fills exactly one page; the smaller treelets of subtrees that ran
+        // out of nodes are packed after them. Traversal order, and so every hit, is unchanged.
+        if (nodes.size() <= 1)
+            return;
+        treelet_nodes = std::max<size_t>(1, treelet_nodes);
+
+        std::vector<uint32_t> order; // order[new index] = old index
+        order.reserve(nodes.size());
+
+        using candidate = std::pair<double, uint32_t>;
+        auto lighter = [&](const candidate& a, const candidate& b)
+        {
+            // Ties go to the lower, that is depth-first earlier, index.
+            return a.first < b.first || (a.first == b.first && a.second > b.second);
+        };
+
+        std::vector<candidate> roots = {{weights[0], 0}};
+        std::vector<candidate> frontier;
+        std::vector<uint32_t> partial; // Nodes of treelets smaller than treelet_nodes
+        while (!roots.empty())
+        {
+            frontier.assign(1, roots.back());
+            roots.pop_back();
+            size_t treelet_begin = order.size();
+
+            for (size_t taken = 0; taken < treelet_nodes && !frontier.empty(); taken++)
+            {
+                std::pop_heap(frontier.begin(), frontier.end(), lighter);
+                uint32_t index = frontier.back().second;
+                frontier.pop_back();
+                order.push_back(index);
+
+                const node& n = nodes[index];
+                for (int c = 0; c < n.child_count; c++)
+                {
+                    if (n.leaf_size[c] == 0)
+                    {
+                        frontier.push_back({weights[n.child[c]], n.child[c]});
+                        std::push_heap(frontier.begin(), frontier.end(), lighter);
+                    }
+                }
+            }
+
+            std::sort(order.begin() + treelet_begin, order.end());
+            if (order.size() - treelet_begin < treelet_nodes)
+            {
+                partial.insert(partial.end(), order.begin() + treelet_begin, order.end());
+                order.resize(treelet_begin);
+            }
+
+            // The heaviest leftover root goes on top of the stack and is laid out next.
+            std::sort(frontier.begin(), frontier.end(), lighter);
+            roots.insert(roots.end(), frontier.begin(), frontier.end());
+        }
+        order.insert(order.end(), partial.begin(), partial.end());
+
+        std::vector<uint32_t> new_index(nodes.size());
+        for (size_t i = 0; i < order.size(); i++)
+            new_index[order[i]] = uint32_t(i);
+
+        node_vector reordered(nodes.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            node n = nodes[order[i]];
+            for (int c = 0; c < n.child_count; c++)
+            {
+                if (n.leaf_size[c] == 0)
+                    n.child[c] = new_index[n.child[c]];
+            }
+            reordered[i] = n;
+        }
+        nodes = std::move(reordered);
+    }
+
+  private:
+    struct alignas(64) node
+    {
+        float origin[3];          // Lower corner of the quantization grid
+        int8_t exponent[3];       // Grid spacing per axis is 2^exponent
+        uint8_t child_count;
+        uint8_t lo[3][width];     // Child box corners in grid units, per axis
+        uint8_t hi[3][width];
+        uint32_t child[width];    // Node index, or the first primitive of a leaf
+        uint8_t leaf_size[width]; // Primitives in a leaf child; 0 for interior children
+
+        double scale(int axis) const
+        {
+            // 2^exponent, assembled directly from its bits; std::ldexp is a library call.
+            uint64_t bits = uint64_t(1023 + exponent[axis]) << 52;
+            double result;
+            std::memcpy(&result, &bits, sizeof(result));
+            return result;
+        }
+
+        aabb child_box(int c) const
+        {
+            double corners[2][3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                corners[0][axis] = origin[axis] + lo[axis][c] * scale(axis);
+                corners[1][axis] = origin[axis] + hi[axis][c] * scale(axis);
+            }
+            return aabb(point3(corners[0][0], corners[0][1], corners[0][2]),
+                        point3(corners[1][0], corners[1][1], corners[1][2]));
+        }
+
+        bool child_hit(int c, const double scale[3], const ray& r, interval ray_t,
+                       double& entry) const
+        {
+            // Slab test against the decoded box of child `c`, as in aabb::hit. On a hit, `entry`
+            // is where the ray enters the box, clamped to ray_t.
+            const point3& orig = r.origin();
+            const vec3& inv_dir = r.inv_direction();
+            for (int axis = 0; axis < 3; axis++)
+            {
+                double box_min = origin[axis] + lo[axis][c] * scale[axis];
+                double box_max = origin[axis] + hi[axis][c] * scale[axis];
+
+                clip_to_slab(box_min, box_max, orig[axis], inv_dir[axis], r.is_negative(axis),
+                             ray_t.min, ray_t.max);
+            }
+            entry = ray_t.min;
+            return ray_t.min < ray_t.max;
+        }
+    };
+
+    static_assert(sizeof(node) == 64, "A compact BVH node must fill exactly one cache line");
+
+    using node_vector = std::vector<node, page_allocator<node>>;
+
+    // Each visited node pushes at most width - 1 more entries than it pops, so the stack stays
+    // within (width - 1) * depth + 1 for trees up to about 80 levels deep.
+    static constexpr int stack_size = 256;
+
+    node_vector nodes; // nodes[0] is the root, at the start of a page
+    std::vector<const hittable*> primitives;
+    std::vector<shared_ptr<hittable>> owned; // Keeps the primitives alive
+    aabb bbox;
+
+    template <typename visit_function>
+    bool find_hit(const ray& r, interval ray_t, hit_record& rec, visit_function on_visit) const
+    {
+        // Children are taken nearest entry first: leaves are tested in that order and
+        // interior children pushed so that the nearest is popped next. Each stack entry keeps
+        // the distance at which the ray enters it, so a subtree pushed before a closer hit was
+        // found is dropped when popped instead of being descended.
+        if (nodes.empty())
+            return false;
+
+        uint32_t stack[stack_size];
+        double stack_entry[stack_size];
+        int stack_top = 0;
+        stack[stack_top] = 0;
+        stack_entry[stack_top++] = ray_t.min;
+
+        bool hit_anything = false;
+        auto closest_so_far = ray_t.max;
+
+        while (stack_top > 0)
+        {
+            stack_top--;
+            if (stack_entry[stack_top] >= closest_so_far)
+                continue;
+
+            uint32_t index = stack[stack_top];
+            on_visit(index);
+            COUNT_TRAVERSAL(nodes, 1);
+
+            const node& n = nodes[index];
+            const double scale[3] = {n.scale(0), n.scale(1), n.scale(2)};
+
+            // Insertion sort of the children hit, by entry distance.
+            int order[width];
+            double entry[width];
+            int hits = 0;
+            for (int c = 0; c < n.child_count; c++)
+            {
+                double t;
+                if (!n.child_hit(c, scale, r, interval(ray_t.min, closest_so_far), t))
+                    continue;
+
+                int k = hits++;
+                for (; k > 0 && entry[k - 1] > t; k--)
+                {
+                    order[k] = order[k - 1];
+                    entry[k] = entry[k - 1];
+                }
+                order[k] = c;
+                entry[k] = t;
+            }
+
+            for (int k = 0; k < hits; k++)
+            {
+                int c = order[k];
+                if (n.leaf_size[c] == 0 || entry[k] >= closest_so_far)
+                    continue;
+
+                for (uint32_t i = n.child[c]; i < n.child[c] + n.leaf_size[c]; i++)
+                {
+                    if (primitives[i]->hit(r, interval(ray_t.min, closest_so_far), rec))
+                    {
+                        hit_anything = true;
+                        closest_so_far = rec.t;
+                    }
+                }
+            }
+
+            for (int k = hits - 1; k >= 0; k--)
+            {
+                int c = order[k];
+                if (n.leaf_size[c] == 0 && entry[k] < closest_so_far)
+                {
+                    stack[stack_top] = n.child[c];
+                    stack_entry[stack_top++] = entry[k];
+                }
+            }
+        }
+
+        return hit_anything;
+    }
+
+    template <typename visit_function>
+    bool find_any(const ray& r, interval ray_t, visit_function on_visit) const
+    {
+        if (nodes.empty())
+            return false;
+
+        uint32_t stack[stack_size];
+        int stack_top = 0;
+        stack[stack_top++] = 0;
+
+        while (stack_top > 0)
+        {
+            uint32_t index = stack[--stack_top];
+            on_visit(index);
+            COUNT_TRAVERSAL(nodes, 1);
+
+            const node& n = nodes[index];
+            const double scale[3] = {n.scale(0), n.scale(1), n.scale(2)};
+            for (int c = 0; c < n.child_count; c++)
+            {
+                double entry;
+                if (!n.child_hit(c, scale, r, ray_t, entry))
+                    continue;
+
+                if (n.leaf_size[c] == 0)
+                {
+                    stack[stack_top++] = n.child[c];
+                    continue;
+                }
+
+                for (uint32_t i = n.child[c]; i < n.child[c] + n.leaf_size[c]; i++)
+                {
+                    if (primitives[i]->occluded(r, ray_t))
+                        return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    void build(const std::vector<shared_ptr<hittable>>& objects, const bvh_build& b)
+    {
+        owned.reserve(b.refs.size());
+        primitives.reserve(b.refs.size());
+        for (int ref : b.refs)
+        {
+            owned.push_back(objects[ref]);
+            primitives.push_back(objects[ref].get());
+        }
+
+        if (b.nodes.empty())
+            return;
+
+        bbox = b.nodes[0].bounds;
+        nodes.reserve(b.nodes.size() / 2 + 1);
+        emit(b, 0);
+    }
+
+    uint32_t emit(const bvh_build& b, int build_index)
+    {
+        // Collapses the binary subtree at `build_index` into a node of up to `width` children
+        // by repeatedly opening the interior child with the largest surface area, then emits
+        // the node and, depth first, the nodes below it.
+        std::vector<int> children;
+        if (b.nodes[build_index].is_leaf())
+            children.push_back(build_index);
+        else
+            children = {b.nodes[build_index].left, b.nodes[build_index].right};
+
+        while (children.size() < width)
+        {
+            int widest = -1;
+            double widest_area = -1;
+            for (size_t i = 0; i < children.size(); i++)
+            {
+                const auto& child = b.nodes[children[i]];
+                if (!child.is_leaf() && bvh_build::surface_area(child.bounds) > widest_area)
+                {
+                    widest = int(i);
+                    widest_area = bvh_build::surface_area(child.bounds);
+                }
+            }
+            if (widest < 0)
+                break;
+
+            const auto& opened = b.nodes[children[widest]];
+            children[widest] = opened.left;
+            children.push_back(opened.right);
+        }
+
+        uint32_t index = uint32_t(nodes.size());
+        nodes.emplace_back();
+
+        node n{};
+        n.child_count = uint8_t(children.size());
+        set_grid(n, b.nodes[build_index].bounds);
+        for (size_t c = 0; c < children.size(); c++)
+        {
+            const auto& child = b.nodes[children[c]];
+            quantize(n, int(c), child.bounds);
+            if (child.is_leaf())
+            {
+                n.child[c] = uint32_t(child.first);
+                n.leaf_size[c] = uint8_t(child.count);
+            }
+        }
+        for (size_t c = 0; c < children.size(); c++)
+        {
+            if (!b.nodes[children[c]].is_leaf())
+                n.child[c] = emit(b, children[c]);
+        }
+
+        nodes[index] = n;
+        return index;
+    }
+
+    static void set_grid(node& n, const aabb& bounds)
+    {
+        // Chooses for each axis a float origin at or below the box and the smallest power of
+        // two spacing whose 255 steps reach past the box.
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const interval& ax = bounds.axis_interval(axis);
+            float origin = float(ax.min);
+            if (double(origin) > ax.min)
+                origin = std::nextafter(origin, -std::numeric_limits<float>::infinity());
+
+            double extent = ax.max - double(origin);
+            int e = extent > 0 ? std::ilogb(extent / 255) : -128;
+            e = std::max(-128, std::min(127, e));
+            while (e > -128 && double(origin) + 255 * std::ldexp(1.0, e - 1) >= ax.max)
+                e--;
+            while (e < 127 && double(origin) + 255 * std::ldexp(1.0, e) < ax.max)
+                e++;
+
+            n.origin[axis] = origin;
+            n.exponent[axis] = int8_t(e);
+        }
+    }
+
+    static void quantize(node& n, int c, const aabb& box)
+    {
+        // Rounds the child box outwards onto the node's grid.
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const interval& ax = box.axis_interval(axis);
+            double origin = n.origin[axis];
+            double scale = std::ldexp(1.0, n.exponent[axis]);
+
+            int lo = int(std::floor((ax.min - origin) / scale));
+            lo = std::max(0, std::min(255, lo));
+            while (lo > 0 && origin + lo * scale > ax.min)
+                lo--;
+
+            int hi = int(std::ceil((ax.max - origin) / scale));
+            hi = std::max(lo, std::min(255, hi));
+            while (hi < 255 && origin + hi * scale < ax.max)
+                hi++;
+
+            n.lo[axis][c] = uint8_t(lo);
+            n.hi[axis][c] = uint8_t(hi);
+        }
+    }
+};
+
+class visit_counter : public hittable
+{
+  public:
+    // Traces through a compact_bvh and counts the visits to each of its nodes. Not
+    // thread-safe: trace through it from one thread.
+
+    mutable std::vector<uint32_t> visits;
+
+    visit_counter(const compact_bvh& bvh) : visits(bvh.node_count()), bvh(bvh) {}
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override
+    {
+        return bvh.hit(r, ray_t, rec, visits.data());
+    }
+
+    bool occluded(const ray& r, interval ray_t) const override
+    {
+        return bvh.occluded(r, ray_t, visits.data());
+    }
+
+    aabb bounding_box() const override { return bvh.bounding_box(); }
+
+  private:
+    const compact_bvh& bvh;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,341 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+// Coordinator/worker tile rendering. The coordinator splits the frame into tiles and hands
+// them to worker processes over a socket; workers build the same scene from the shared
+// render_config, render each tile's unnormalized sums and send them back. Because every
+// pixel's samples are seeded by pixel and sample index alone, the assembled image is
+// bit-identical to a single-process render with the same settings.
+
+#include "net.h"
+#include "scene.h"
+
+#include <chrono>
+#include <deque>
+#include <poll.h>
+#include <sys/wait.h>
+
+enum message_type : uint32_t
+{
+    msg_config = 1,  // coordinator -> worker: render_config
+    msg_tile = 2,    // coordinator -> worker: tile_request
+    msg_result = 3,  // worker -> coordinator: tile_request followed by the tile's sums
+    msg_shutdown = 4 // coordinator -> worker: no more work
+};
+
+struct tile_request
+{
+    int32_t id;
+    int32_t x0, y0, x1, y1;
+    int32_t sample_begin, sample_end;
+};
+
+inline int run_worker(const endpoint& ep)
+{
+    // The coordinator may still be starting up, so retry the connection for a while.
+    int fd = -1;
+    for (int attempt = 0; attempt < 100 && fd < 0; attempt++)
+    {
+        fd = open_connection(ep);
+        if (fd < 0)
+            usleep(100 * 1000);
+    }
+    if (fd < 0)
+    {
+        std::cerr << "worker: could not connect to coordinator\n";
+        return 1;
+    }
+
+    scene s;
+    bool configured = false;
+    uint32_t type;
+    std::vector<char> payload;
+    std::vector<char> reply;
+
+    while (recv_message(fd, type, payload))
+    {
+        if (type == msg_config && payload.size() == sizeof(render_config))
+        {
+            render_config config;
+            std::memcpy(&config, payload.data(), sizeof(config));
+            s = make_scene(config);
+            s.cam.initialize();
+            configured = true;
+        }
+        else if (type == msg_tile && configured && payload.size() == sizeof(tile_request))
+        {
+            tile_request req;
+            std::memcpy(&req, payload.data(), sizeof(req));
+
+            tile t(req.x0, req.y0, req.x1, req.y1);
+            std::vector<color> sums(t.pixel_count());
+            render_tile_parallel(s.cam, s.world, s.lights, t, req.sample_begin, req.sample_end,
+                                 sums.data());
+
+            reply.resize(sizeof(req) + sums.size() * sizeof(color));
+            std::memcpy(reply.data(), &req, sizeof(req));
+            std::memcpy(reply.data() + sizeof(req), sums.data(), sums.size() * sizeof(color));
+            if (!send_message(fd, msg_result, reply.data(), reply.size()))
+                break;
+        }
+        else if (type == msg_shutdown)
+        {
+            break;
+        }
+    }
+
+    close(fd);
+    return 0;
+}
+
+class coordinator
+{
+  public:
+    int tile_size = 32;
+    double late_after_seconds = 30; // A tile out this long may be given to an idle worker too
+    double stall_seconds = 5;       // A worker silent this long mid-message is dropped
+    int local_workers = 0;          // Worker processes to fork on this machine
+
+    int run(const endpoint& ep, const render_config& config)
+    {
+        // Renders the frame described by `config` on connected workers and writes it to
+        // std::cout as a PPM image.
+        scene s = make_scene(config);
+        s.cam.initialize();
+        int image_width = s.cam.image_width;
+        int image_height = s.cam.get_image_height();
+
+        listener = open_listener(ep);
+        if (listener < 0)
+        {
+            std::cerr << "coordinator: could not listen: " << std::strerror(errno) << '\n';
+            return 1;
+        }
+
+        std::vector<pid_t> children;
+        for (int n = 0; n < local_workers; n++)
+        {
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                close(listener);
+                _exit(run_worker(ep));
+            }
+            if (pid > 0)
+                children.push_back(pid);
+        }
+
+        frame.assign(size_t(image_width) * image_height, color(0, 0, 0));
+        auto tiles = split_into_tiles(image_width, image_height, tile_size);
+        states.assign(tiles.size(), tile_state());
+        for (size_t i = 0; i < tiles.size(); i++)
+            pending.push_back(int(i));
+
+        size_t done_count = 0;
+        while (done_count < tiles.size())
+        {
+            std::vector<pollfd> fds;
+            fds.push_back({listener, POLLIN, 0});
+            for (const auto& w : workers)
+                fds.push_back({w.fd, POLLIN, 0});
+
+            if (poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR)
+                break;
+
+            if (fds[0].revents & POLLIN)
+                accept_worker(config);
+
+            for (size_t k = 1; k < fds.size(); k++)
+            {
+                if (!(fds[k].revents & (POLLIN | POLLHUP | POLLERR)))
+                    continue;
+
+                // Receiving blocks until the whole message is in, or until the worker has sent
+                // nothing for stall_seconds, which counts as a dead worker.
+                auto& w = workers[k - 1];
+                uint32_t type;
+                if (!recv_message(w.fd, type, payload) || type != msg_result)
+                {
+                    drop_worker(w);
+                    continue;
+                }
+
+                done_count += store_result(tiles, image_width);
+                w.tile = -1;
+            }
+
+            workers.erase(std::remove_if(workers.begin(), workers.end(),
+                                         [](const worker_state& w) { return w.fd < 0; }),
+                          workers.end());
+
+            std::clog << "\rTiles remaining: " << (tiles.size() - done_count) << "   "
+                      << std::flush;
+            dispatch(tiles, s.cam.samples_per_pixel);
+        }
+
+        for (auto& w : workers)
+        {
+            send_message(w.fd, msg_shutdown, nullptr, 0);
+            close(w.fd);
+        }
+        workers.clear();
+        close(listener);
+        if (ep.is_unix)
+            unlink(ep.path.c_str());
+
+        for (auto pid : children)
+            waitpid(pid, nullptr, 0);
+
+        if (done_count < tiles.size())
+        {
+            std::cerr << "\ncoordinator: render aborted\n";
+            return 1;
+        }
+
+        auto pixel_samples_scale = 1.0 / s.cam.samples_per_pixel;
+        std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+        for (const auto& pixel_color : frame)
+            write_color(std::cout, pixel_samples_scale * pixel_color);
+
+        std::clog << "\rDone.                 \n";
+        return 0;
+    }
+
+  private:
+    using clock = std::chrono::steady_clock;
+
+    struct worker_state
+    {
+        int fd;
+        int tile; // Tile being rendered, or -1 when idle
+    };
+
+    struct tile_state
+    {
+        bool done = false;
+        int assignees = 0;
+        clock::time_point started;
+    };
+
+    int listener = -1;
+    std::vector<worker_state> workers;
+    std::vector<tile_state> states;
+    std::deque<int> pending;
+    std::vector<color> frame;
+    std::vector<char> payload;
+
+    void accept_worker(const render_config& config)
+    {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0)
+            return;
+
+        if (!set_receive_timeout(fd, stall_seconds) ||
+            !send_message(fd, msg_config, &config, sizeof(config)))
+        {
+            close(fd);
+            return;
+        }
+        workers.push_back({fd, -1});
+    }
+
+    void drop_worker(worker_state& w)
+    {
+        // A worker that disconnects or misbehaves gives its tile back to the queue, unless
+        // another worker is still on it.
+        if (w.tile >= 0)
+        {
+            auto& st = states[w.tile];
+            st.assignees--;
+            if (!st.done && st.assignees == 0)
+                pending.push_front(w.tile);
+        }
+        close(w.fd);
+        w.fd = -1;
+    }
+
+    size_t store_result(const std::vector<tile>& tiles, int image_width)
+    {
+        // Copies a worker's tile into the frame. Returns 1 if this completed a tile, or 0 for
+        // a late duplicate of a tile that is already done.
+        if (payload.size() < sizeof(tile_request))
+            return 0;
+
+        tile_request req;
+        std::memcpy(&req, payload.data(), sizeof(req));
+        if (req.id < 0 || size_t(req.id) >= tiles.size())
+            return 0;
+
+        auto& st = states[req.id];
+        st.assignees--;
+
+        const tile& t = tiles[req.id];
+        if (st.done || payload.size() != sizeof(req) + t.pixel_count() * sizeof(color))
+            return 0;
+
+        auto sums = reinterpret_cast<const color*>(payload.data() + sizeof(req));
+        for (int j = t.y0; j < t.y1; j++)
+        {
+            std::copy(sums + (j - t.y0) * t.width(), sums + (j - t.y0 + 1) * t.width(),
+                      frame.begin() + size_t(j) * image_width + t.x0);
+        }
+
+        st.done = true;
+        return 1;
+    }
+
+    void dispatch(const std::vector<tile>& tiles, int samples_per_pixel)
+    {
+        auto now = clock::now();
+        for (auto& w : workers)
+        {
+            if (w.fd < 0 || w.tile >= 0)
+                continue;
+
+            int next = -1;
+            while (!pending.empty() && next < 0)
+            {
+                next = pending.front();
+                pending.pop_front();
+                if (states[next].done)
+                    next = -1;
+            }
+
+            if (next < 0)
+            {
+                // Nothing queued: speculatively duplicate the longest-running late tile so a
+                // slow or hung worker can't hold up the frame.
+                double oldest = late_after_seconds;
+                for (size_t i = 0; i < states.size(); i++)
+                {
+                    const auto& st = states[i];
+                    double age = std::chrono::duration<double>(now - st.started).count();
+                    if (!st.done && st.assignees > 0 && age >= oldest)
+                    {
+                        oldest = age;
+                        next = int(i);
+                    }
+                }
+            }
+
+            if (next < 0)
+                return;
+
+            w.tile = next;
+            states[next].assignees++;
+
+            const tile& t = tiles[next];
+            tile_request req{next, t.x0, t.y0, t.x1, t.y1, 0, samples_per_pixel};
+            if (!send_message(w.fd, msg_tile, &req, sizeof(req)))
+            {
+                // The worker is gone: give the tile back, and drop the worker so that later
+                // rounds don't pick it again before poll reports the hangup.
+                drop_worker(w);
+                continue;
+            }
+            states[next].started = now;
+        }
+    }
+};
+
+#endif
\ No newline at end of file
@@ -6,14 +6,18 @@
 #include "ray.h"
 #include "vec3.h"
 
+class hittable;
+class light_bounds;
 class material;
 
 class hit_record
 {
   public:
     point3 p;
+    vec3 p_error; // Bound on the rounding error in each coordinate of p
     vec3 normal;
     shared_ptr<material> mat;
+    const hittable* object; // The primitive that was hit, used to look up light sampling pdfs
     double t;
     bool front_face;
 
@@ -25,8 +29,40 @@ class hit_record
         front_face = dot(r.direction(), outward_normal) < 0;
         normal = front_face ? outward_normal : -outward_normal;
     }
+
+    ray spawn_ray(const vec3& direction, double time, bool unit_direction = false) const
+    {
+        // A ray leaving the surface at p, at the `time` of the ray that arrived there. Its
+        // origin is moved along the normal, to the side `direction` heads for, just past p's
+        // error bound, and each coordinate is then rounded away from p, so the ray starts
+        // clear of the surface it leaves and cannot hit it again near t = 0. Rays can then be
+        // searched from t = 0, at any scene scale, instead of from a fixed epsilon.
+        vec3 offset = dot(abs(normal), p_error) * normal;
+        if (dot(direction, normal) < 0)
+            offset = -offset;
+
+        point3 origin = p + offset;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (offset[axis] > 0)
+                origin[axis] = next_double_up(origin[axis]);
+            else if (offset[axis] < 0)
+                origin[axis] = next_double_down(origin[axis]);
+        }
+        return ray(origin, direction, time, unit_direction);
+    }
 };
 
+inline point3 project_to_plane(const point3& p, const vec3& normal, double D, vec3& p_error)
+{
+    // Moves p, a point computed near the plane dot(normal, x) = D, onto it, up to the rounding
+    // of the projection itself, which `p_error` bounds. A point found as r.at(t) would carry
+    // the error of t instead, which grows with the distance the ray travelled.
+    point3 q = p - (dot(normal, p) - D) * normal;
+    p_error = gamma_bound(6) * (abs(q) + vec3(std::fabs(D), std::fabs(D), std::fabs(D)));
+    return q;
+}
+
 class hittable
 {
   public:
@@ -34,7 +70,37 @@ class hittable
 
     virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0;
 
+    // Any-hit query for shadow and visibility rays: returns true as soon as anything blocks
+    // the ray inside `ray_t`, without searching for the closest hit or filling a record.
+    virtual bool occluded(const ray& r, interval ray_t) const
+    {
+        hit_record rec;
+        return hit(r, ray_t, rec);
+    }
+
+    // Bounds over the whole frame interval.
     virtual aabb bounding_box() const = 0;
+
+    // Bounds at `time` in [0, 1]. Moving primitives move linearly, so that the box at any time
+    // lies within the box interpolated from the boxes at 0 and 1, which a BVH can store
+    // instead of the bounds over the whole interval.
+    virtual aabb bounds_at(double time) const { return bounding_box(); }
+
+    // Bounds of the part of the primitive inside `region`, for BVH builders that split
+    // primitives between nodes. The result only has to contain that part, and the whole box
+    // always does.
+    virtual aabb clipped_box(const aabb& region) const { return bounding_box(); }
+
+    // Light sampling support. Primitives that can act as area lights return the solid angle
+    // density of sampling `direction` from `origin`, and generate such directions from a
+    // point in [0,1)^2.
+    virtual double pdf_value(const point3& origin, const vec3& direction) const { return 0.0; }
+
+    virtual vec3 random(const point3& origin, const vec3& u) const { return vec3(1, 0, 0); }
+
+    // Fills in the emitted power and emission directions of an emissive primitive, for
+    // importance-based light selection. Returns false for primitives that do not emit.
+    virtual bool emitter_bounds(light_bounds& lb) const { return false; }
 };
 
 #endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "aabb.h"
 #include "hittable.h"
+#include "traversal_stats.h"
 
 #include <vector>
 
@@ -24,6 +25,7 @@ class hittable_list : public hittable
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override
     {
+        COUNT_TRAVERSAL(rays, 1);
         hit_record temp_rec;
         bool hit_anything = false;
         auto closest_so_far = ray_t.max;
@@ -41,8 +43,28 @@ class hittable_list : public hittable
         return hit_anything;
     }
 
+    bool occluded(const ray& r, interval ray_t) const override
+    {
+        COUNT_TRAVERSAL(rays, 1);
+        for (const auto& object : objects)
+        {
+            if (object->occluded(r, ray_t))
+                return true;
+        }
+
+        return false;
+    }
+
     aabb bounding_box() const override { return bbox; }
 
+    aabb bounds_at(double time) const override
+    {
+        aabb box = aabb::empty;
+        for (const auto& object : objects)
+            box = aabb(box, object->bounds_at(time));
+        return box;
+    }
+
   private:
     aabb bbox;
 };
@@ -0,0 +1,344 @@
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include "hittable.h"
+#include "light_bounds.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+enum class light_sampler_type
+{
+    bvh,     // Light BVH: proportional to estimated contribution at the shading point
+    uniform, // Every light equally likely
+    power    // Proportional to emitted power
+};
+
+class light_list
+{
+  public:
+    // The emissive primitives of a scene, gathered while the scene is built. The camera picks
+    // one per diffuse bounce for next-event estimation. Lights are picked uniformly until
+    // build() prepares one of the importance-based strategies.
+
+    light_list() {}
+
+    void add(shared_ptr<hittable> light)
+    {
+        index.emplace(light.get(), lights.size());
+        lights.push_back(light);
+        strategy = light_sampler_type::uniform;
+    }
+
+    bool empty() const { return lights.empty(); }
+
+    size_t size() const { return lights.size(); }
+
+    void build(light_sampler_type type)
+    {
+        // Prepares the selection strategy. Must be called again after adding lights.
+        strategy = type;
+        bounds.resize(lights.size());
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            if (!lights[i]->emitter_bounds(bounds[i]))
+                bounds[i] = light_bounds();
+        }
+
+        if (type == light_sampler_type::power)
+            build_power_cdf();
+        else if (type == light_sampler_type::bvh)
+            build_bvh();
+    }
+
+    const hittable* sample(const point3& p, const vec3& n, double u, double& pmf) const
+    {
+        // Picks a light for shading point `p` with normal `n` and returns the probability of
+        // having picked it.
+        pmf = 0;
+        if (lights.empty())
+            return nullptr;
+
+        switch (strategy)
+        {
+        case light_sampler_type::power:
+            return sample_power(u, pmf);
+        case light_sampler_type::bvh:
+            return sample_bvh(p, n, u, pmf);
+        case light_sampler_type::uniform:
+        default:
+        {
+            size_t i = std::min(size_t(u * lights.size()), lights.size() - 1);
+            pmf = 1.0 / lights.size();
+            return lights[i].get();
+        }
+        }
+    }
+
+    double pmf(const point3& p, const vec3& n, const hittable* light) const
+    {
+        // Probability that sample() returns `light`; zero for primitives not in the list.
+        auto it = index.find(light);
+        if (it == index.end())
+            return 0;
+
+        switch (strategy)
+        {
+        case light_sampler_type::power:
+            return power_total > 0 ? bounds[it->second].phi / power_total : 0;
+        case light_sampler_type::bvh:
+            return pmf_bvh(p, n, it->second);
+        case light_sampler_type::uniform:
+        default:
+            return 1.0 / lights.size();
+        }
+    }
+
+  private:
+    struct light_bvh_node
+    {
+        // Interior nodes keep their first child right after themselves and the second at
+        // `child_or_light`; leaves store the index of their light there instead.
+        light_bounds lb;
+        int child_or_light;
+        bool is_leaf;
+    };
+
+    std::vector<shared_ptr<hittable>> lights;
+    std::unordered_map<const hittable*, size_t> index;
+    light_sampler_type strategy = light_sampler_type::uniform;
+
+    std::vector<light_bounds> bounds;
+    std::vector<double> power_cdf;
+    double power_total = 0;
+    std::vector<light_bvh_node> nodes;
+    std::vector<uint64_t> bit_trails; // Per light: the left/right choices from the root
+
+    void build_power_cdf()
+    {
+        power_cdf.resize(lights.size());
+        power_total = 0;
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            power_total += bounds[i].phi;
+            power_cdf[i] = power_total;
+        }
+    }
+
+    const hittable* sample_power(double u, double& pmf) const
+    {
+        if (power_total <= 0)
+            return nullptr;
+
+        auto it = std::upper_bound(power_cdf.begin(), power_cdf.end(), u * power_total);
+        size_t i = std::min(size_t(it - power_cdf.begin()), lights.size() - 1);
+        pmf = bounds[i].phi / power_total;
+        return lights[i].get();
+    }
+
+    void build_bvh()
+    {
+        nodes.clear();
+        bit_trails.assign(lights.size(), 0);
+
+        std::vector<int> emitters;
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            if (bounds[i].phi > 0)
+                emitters.push_back(int(i));
+        }
+
+        if (!emitters.empty())
+            build_bvh_node(emitters, 0, emitters.size(), 0, 0);
+    }
+
+    light_bounds build_bvh_node(std::vector<int>& emitters, size_t start, size_t end,
+                                uint64_t bit_trail, int depth)
+    {
+        if (end - start == 1)
+        {
+            int light = emitters[start];
+            nodes.push_back({bounds[light], light, true});
+            bit_trails[light] = bit_trail;
+            return bounds[light];
+        }
+
+        // Bounds of the light centroids pick the candidate split axes.
+        aabb centroid_bounds;
+        for (size_t i = start; i < end; i++)
+        {
+            auto c = bounds[emitters[i]].centroid();
+            centroid_bounds = aabb(centroid_bounds, aabb(c, c));
+        }
+
+        // Bucketed surface area orientation heuristic (SAOH): for each axis, bin the lights
+        // by centroid and evaluate the cost of splitting between every pair of buckets.
+        constexpr int bucket_count = 12;
+        double min_cost = infinity;
+        int min_axis = -1, min_bucket = -1;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const interval& ax = centroid_bounds.axis_interval(axis);
+            if (ax.size() <= 0)
+                continue;
+
+            light_bounds buckets[bucket_count];
+            for (size_t i = start; i < end; i++)
+            {
+                const auto& lb = bounds[emitters[i]];
+                int b = bucket_of(lb.centroid()[axis], ax, bucket_count);
+                buckets[b] = light_bounds(buckets[b], lb);
+            }
+
+            for (int split = 0; split < bucket_count - 1; split++)
+            {
+                light_bounds below, above;
+                for (int b = 0; b <= split; b++)
+                    below = light_bounds(below, buckets[b]);
+                for (int b = split + 1; b < bucket_count; b++)
+                    above = light_bounds(above, buckets[b]);
+                if (below.phi == 0 || above.phi == 0)
+                    continue;
+
+                double cost = split_cost(below, centroid_bounds, axis) +
+                              split_cost(above, centroid_bounds, axis);
+                if (cost < min_cost)
+                {
+                    min_cost = cost;
+                    min_axis = axis;
+                    min_bucket = split;
+                }
+            }
+        }
+
+        size_t mid;
+        if (min_axis == -1 || depth >= 32)
+        {
+            // Coincident centroids make any split as good as another. Past depth 32 median
+            // splits also keep every bit trail within its 64 bits.
+            mid = (start + end) / 2;
+        }
+        else
+        {
+            const interval& ax = centroid_bounds.axis_interval(min_axis);
+            auto it = std::partition(emitters.begin() + start, emitters.begin() + end,
+                                     [&](int light)
+                                     {
+                                         auto c = bounds[light].centroid()[min_axis];
+                                         return bucket_of(c, ax, bucket_count) <= min_bucket;
+                                     });
+            mid = size_t(it - emitters.begin());
+            if (mid == start || mid == end)
+                mid = (start + end) / 2;
+        }
+
+        size_t node_index = nodes.size();
+        nodes.push_back({light_bounds(), 0, false});
+
+        auto left = build_bvh_node(emitters, start, mid, bit_trail, depth + 1);
+        nodes[node_index].child_or_light = int(nodes.size());
+        auto right =
+            build_bvh_node(emitters, mid, end, bit_trail | (uint64_t(1) << depth), depth + 1);
+
+        nodes[node_index].lb = light_bounds(left, right);
+        return nodes[node_index].lb;
+    }
+
+    static int bucket_of(double c, const interval& ax, int bucket_count)
+    {
+        int b = int(bucket_count * ((c - ax.min) / ax.size()));
+        return std::clamp(b, 0, bucket_count - 1);
+    }
+
+    static double split_cost(const light_bounds& lb, const aabb& centroid_bounds, int axis)
+    {
+        if (lb.phi == 0)
+            return 0;
+
+        // Penalize splitting along short axes, which yields long thin clusters.
+        double max_extent = std::fmax(centroid_bounds.x.size(),
+                                      std::fmax(centroid_bounds.y.size(),
+                                                centroid_bounds.z.size()));
+        double kr = max_extent / centroid_bounds.axis_interval(axis).size();
+
+        double dx = lb.bounds.x.size(), dy = lb.bounds.y.size(), dz = lb.bounds.z.size();
+        double area = 2 * (dx * dy + dy * dz + dz * dx);
+        return lb.phi * lb.orientation_measure() * kr * area;
+    }
+
+    const hittable* sample_bvh(const point3& p, const vec3& n, double u, double& pmf) const
+    {
+        // Descend from the root, choosing each child in proportion to its importance and
+        // reusing the remapped random number at the next level.
+        if (nodes.empty())
+            return nullptr;
+
+        int node_index = 0;
+        pmf = 1;
+        while (true)
+        {
+            const auto& node = nodes[node_index];
+            if (node.is_leaf)
+            {
+                if (node_index > 0 || node.lb.importance(p, n) > 0)
+                    return lights[node.child_or_light].get();
+                pmf = 0;
+                return nullptr;
+            }
+
+            auto ci0 = nodes[node_index + 1].lb.importance(p, n);
+            auto ci1 = nodes[node.child_or_light].lb.importance(p, n);
+            if (ci0 == 0 && ci1 == 0)
+            {
+                pmf = 0;
+                return nullptr;
+            }
+
+            auto p0 = ci0 / (ci0 + ci1);
+            if (u < p0)
+            {
+                pmf *= p0;
+                u = std::fmin(u / p0, 1 - 0x1p-53);
+                node_index = node_index + 1;
+            }
+            else
+            {
+                pmf *= 1 - p0;
+                u = std::fmin((u - p0) / (1 - p0), 1 - 0x1p-53);
+                node_index = node.child_or_light;
+            }
+        }
+    }
+
+    double pmf_bvh(const point3& p, const vec3& n, size_t light) const
+    {
+        // Replays the root-to-leaf choices recorded in the light's bit trail.
+        if (nodes.empty() || bounds[light].phi == 0)
+            return 0;
+
+        uint64_t bit_trail = bit_trails[light];
+        int node_index = 0;
+        double pmf = 1;
+        while (true)
+        {
+            const auto& node = nodes[node_index];
+            if (node.is_leaf)
+                return (node_index > 0 || node.lb.importance(p, n) > 0) ? pmf : 0;
+
+            auto ci0 = nodes[node_index + 1].lb.importance(p, n);
+            auto ci1 = nodes[node.child_or_light].lb.importance(p, n);
+            if (ci0 == 0 && ci1 == 0)
+                return 0;
+
+            bool right = bit_trail & 1;
+            pmf *= (right ? ci1 : ci0) / (ci0 + ci1);
+            node_index = right ? node.child_or_light : node_index + 1;
+            bit_trail >>= 1;
+        }
+    }
+};
+
+#endif
\ No newline at end of file
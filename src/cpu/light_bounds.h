@@ -0,0 +1,190 @@
+#ifndef LIGHT_BOUNDS_H
+#define LIGHT_BOUNDS_H
+
+#include "aabb.h"
+
+class light_bounds
+{
+  public:
+    // Conservative description of what an emitter (or a cluster of emitters) can contribute:
+    // where it is, how much power it emits, and the cone of directions it emits into. The
+    // emission normals lie within `cos_theta_o` of `w`, and light leaves each surface normal at
+    // most `cos_theta_e` away from it (pi/2 for diffuse emitters).
+
+    aabb bounds;
+    vec3 w = vec3(0, 0, 1);
+    double phi = 0;
+    double cos_theta_o = 1;
+    double cos_theta_e = 1;
+    bool two_sided = false;
+
+    light_bounds() {}
+
+    light_bounds(const aabb& bounds, const vec3& w, double phi, double cos_theta_o,
+                 double cos_theta_e, bool two_sided)
+        : bounds(bounds), w(w), phi(phi), cos_theta_o(cos_theta_o), cos_theta_e(cos_theta_e),
+          two_sided(two_sided)
+    {
+    }
+
+    light_bounds(const light_bounds& a, const light_bounds& b)
+    {
+        // Create the bounds enclosing both inputs. Bounds without power are treated as empty.
+        if (a.phi == 0)
+        {
+            *this = b;
+            return;
+        }
+        if (b.phi == 0)
+        {
+            *this = a;
+            return;
+        }
+
+        bounds = aabb(a.bounds, b.bounds);
+        phi = a.phi + b.phi;
+        cone_union(a.w, a.cos_theta_o, b.w, b.cos_theta_o, w, cos_theta_o);
+        cos_theta_e = std::fmin(a.cos_theta_e, b.cos_theta_e);
+        two_sided = a.two_sided || b.two_sided;
+    }
+
+    point3 centroid() const
+    {
+        return 0.5 * point3(bounds.x.min + bounds.x.max, bounds.y.min + bounds.y.max,
+                            bounds.z.min + bounds.z.max);
+    }
+
+    double importance(const point3& p, const vec3& n) const
+    {
+        // Upper bound on the contribution of the emitters to a point `p` with surface normal
+        // `n` (pass a zero normal to ignore surface orientation), following Conty Estevez and
+        // Kulla's many-light sampling as formulated in pbrt-v4.
+        if (phi == 0)
+            return 0;
+
+        point3 pc = centroid();
+        vec3 diagonal(bounds.x.size(), bounds.y.size(), bounds.z.size());
+        auto d2 = std::fmax((p - pc).length_squared(), diagonal.length() / 2);
+
+        vec3 wi = p - pc;
+        auto wi_len = wi.length();
+        wi = wi_len > 0 ? wi / wi_len : w;
+
+        // Angle between the emission axis and the direction to `p`.
+        auto cos_theta_w = dot(w, wi);
+        if (two_sided)
+            cos_theta_w = std::fabs(cos_theta_w);
+        auto sin_theta_w = safe_sqrt(1 - cos_theta_w * cos_theta_w);
+
+        // Angle subtended by the bounds as seen from `p`.
+        double cos_theta_b = bounding_cone_cos(p);
+        auto sin_theta_b = safe_sqrt(1 - cos_theta_b * cos_theta_b);
+
+        // Minimum angle between any emission direction and the direction to `p`.
+        auto sin_theta_o = safe_sqrt(1 - cos_theta_o * cos_theta_o);
+        auto cos_theta_x = cos_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+        auto sin_theta_x = sin_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+        auto cos_theta_p = cos_sub_clamped(sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b);
+        if (cos_theta_p <= cos_theta_e)
+            return 0;
+
+        auto result = phi * cos_theta_p / d2;
+
+        if (n.length_squared() > 0)
+        {
+            auto cos_theta_i = std::fabs(dot(wi, n));
+            auto sin_theta_i = safe_sqrt(1 - cos_theta_i * cos_theta_i);
+            result *= cos_sub_clamped(sin_theta_i, cos_theta_i, sin_theta_b, cos_theta_b);
+        }
+
+        return std::fmax(result, 0.0);
+    }
+
+    double orientation_measure() const
+    {
+        // Solid-angle measure of the emission cone widened by the emission spread, used by the
+        // light BVH builder's surface area orientation heuristic.
+        auto theta_o = std::acos(clamp_cos(cos_theta_o));
+        auto theta_e = std::acos(clamp_cos(cos_theta_e));
+        auto theta_w = std::fmin(theta_o + theta_e, pi);
+        auto sin_theta_o = safe_sqrt(1 - cos_theta_o * cos_theta_o);
+        return 2 * pi * (1 - cos_theta_o) +
+               pi / 2 *
+                   (2 * theta_w * sin_theta_o - std::cos(theta_o - 2 * theta_w) -
+                    2 * theta_o * sin_theta_o + cos_theta_o);
+    }
+
+  private:
+    static double safe_sqrt(double x) { return std::sqrt(std::fmax(0.0, x)); }
+
+    static double clamp_cos(double x) { return std::fmin(1.0, std::fmax(-1.0, x)); }
+
+    static double cos_sub_clamped(double sin_a, double cos_a, double sin_b, double cos_b)
+    {
+        // cos(max(0, a - b))
+        if (cos_a > cos_b)
+            return 1;
+        return cos_a * cos_b + sin_a * sin_b;
+    }
+
+    static double sin_sub_clamped(double sin_a, double cos_a, double sin_b, double cos_b)
+    {
+        // sin(max(0, a - b))
+        if (cos_a > cos_b)
+            return 0;
+        return sin_a * cos_b - cos_a * sin_b;
+    }
+
+    double bounding_cone_cos(const point3& p) const
+    {
+        // Cosine of the half-angle of the cone from `p` that contains the bounding sphere of
+        // the box; -1 (every direction) when `p` is inside it.
+        point3 pc = centroid();
+        vec3 diagonal(bounds.x.size(), bounds.y.size(), bounds.z.size());
+        auto radius2 = diagonal.length_squared() / 4;
+        auto dist2 = (p - pc).length_squared();
+        if (dist2 < radius2)
+            return -1;
+        return safe_sqrt(1 - radius2 / dist2);
+    }
+
+    static void cone_union(const vec3& wa, double cos_a, const vec3& wb, double cos_b, vec3& w,
+                           double& cos_theta)
+    {
+        // Smallest cone (approximately) containing the cones around `wa` and `wb`.
+        auto theta_a = std::acos(clamp_cos(cos_a));
+        auto theta_b = std::acos(clamp_cos(cos_b));
+        auto theta_d = std::acos(clamp_cos(dot(wa, wb)));
+
+        if (std::fmin(theta_d + theta_b, pi) <= theta_a)
+        {
+            w = wa;
+            cos_theta = cos_a;
+            return;
+        }
+        if (std::fmin(theta_d + theta_a, pi) <= theta_b)
+        {
+            w = wb;
+            cos_theta = cos_b;
+            return;
+        }
+
+        auto theta_o = (theta_a + theta_d + theta_b) / 2;
+        vec3 axis = cross(wa, wb);
+        if (theta_o >= pi || axis.length_squared() == 0)
+        {
+            w = wa;
+            cos_theta = -1;
+            return;
+        }
+
+        // Rotate `wa` towards `wb` by theta_o - theta_a (Rodrigues' rotation formula).
+        axis = unit_vector(axis);
+        auto theta_r = theta_o - theta_a;
+        w = wa * std::cos(theta_r) + cross(axis, wa) * std::sin(theta_r) +
+            axis * dot(axis, wa) * (1 - std::cos(theta_r));
+        cos_theta = std::cos(theta_o);
+    }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "rtweekend.h"
+
+#include "scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// Measures how efficiently each light selection strategy renders a scene with many emitters:
+// renders it with every strategy at the same sample count, times the render and prints the
+// RMSE of the image against a high sample count reference. All strategies are unbiased, so
+// their error only differs in variance, and variance times render time is the figure to
+// compare: a strategy with half the product reaches any given error in half the time. Errors
+// are taken on linear radiance, before the output clamp, so that the occasional bright pixel
+// of a poorly chosen light counts in full. The mean over the image is dominated by the few
+// pixels that see emitters through glass and metal, noise that no light strategy reaches, so
+// the median pixel's error is reported too. Every figure is printed as one `key: value` line,
+// as bvh_stats does, so that strategies can be compared run to run.
+
+struct named_light_sampler
+{
+    std::string name;
+    light_sampler_type type;
+};
+
+std::vector<color> render_pixels(camera cam, const scene& s, int spp, int seed, double& seconds)
+{
+    // Renders the scene's view at `spp` samples per pixel with its current light strategy,
+    // returning the mean radiance of every pixel and the time the render took.
+    cam.samples_per_pixel = spp;
+    cam.seed = seed;
+    cam.initialize();
+
+    int image_width = cam.image_width;
+    int image_height = cam.get_image_height();
+    std::vector<color> sums(size_t(image_width) * image_height);
+
+    auto start_time = std::chrono::steady_clock::now();
+    render_tile_parallel(cam, s.world, s.lights, tile(0, 0, image_width, image_height), 0, spp,
+                         sums.data());
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    for (auto& sum : sums)
+        sum /= spp;
+    return sums;
+}
+
+void squared_errors(const std::vector<color>& a, const std::vector<color>& b, double& mean,
+                    double& median)
+{
+    // Mean and median over the pixels of the squared error, averaged over the channels.
+    std::vector<double> errors(a.size());
+    for (size_t i = 0; i < a.size(); i++)
+        errors[i] = (a[i] - b[i]).length_squared() / 3;
+
+    mean = std::accumulate(errors.begin(), errors.end(), 0.0) / errors.size();
+    std::nth_element(errors.begin(), errors.begin() + errors.size() / 2, errors.end());
+    median = errors[errors.size() / 2];
+}
+
+int main(int argc, char* argv[])
+{
+    render_config config;
+    config.scene_id = 2;
+    config.image_width = 80;
+    std::string sampler_name = "all";
+    int spp = 16, reference_spp = 1024, runs = 3;
+
+    for (int i = 1; i < argc; i++)
+    {
+        auto arg = std::string(argv[i]);
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--scene" && has_value)
+            config.scene_id = std::atoi(argv[++i]);
+        else if (arg == "--primitives" && has_value)
+            config.primitive_count = std::atoi(argv[++i]);
+        else if (arg == "--width" && has_value)
+            config.image_width = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--light-sampler" && has_value)
+            sampler_name = argv[++i];
+        else if (arg == "--spp" && has_value)
+            spp = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--reference-spp" && has_value)
+            reference_spp = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--runs" && has_value)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else
+        {
+            std::cerr
+                << "Usage: light_sampler_efficiency [options]\n"
+                   "  --scene <n>           Scene with lights, as for cpu_pt (default 2)\n"
+                   "  --primitives <n>      Scene 5: number of spheres\n"
+                   "  --width <px>          Image width (default 80)\n"
+                   "  --light-sampler <s>   bvh, uniform, power or all (default)\n"
+                   "  --spp <n>             Samples per pixel of the measured renders\n"
+                   "                        (default 16)\n"
+                   "  --reference-spp <n>   Samples per pixel of the reference (default 1024)\n"
+                   "  --runs <n>            Measured renders per strategy, under different\n"
+                   "                        seeds (default 3)\n";
+            return 1;
+        }
+    }
+
+    std::vector<named_light_sampler> samplers = {
+        {"uniform", light_sampler_type::uniform},
+        {"power", light_sampler_type::power},
+        {"bvh", light_sampler_type::bvh},
+    };
+
+    auto selected = [&](const named_light_sampler& named)
+    { return sampler_name == "all" || sampler_name == named.name; };
+    if (std::none_of(samplers.begin(), samplers.end(), selected))
+    {
+        std::cerr << "light_sampler_efficiency: unknown light sampler " << sampler_name << '\n';
+        return 1;
+    }
+
+    scene s = make_scene(config);
+    if (s.lights.empty())
+    {
+        std::cerr << "light_sampler_efficiency: scene " << config.scene_id << " has no lights\n";
+        return 1;
+    }
+
+    // The reference uses the light BVH, which converges fastest, under a seed no measured
+    // render uses, so that it shares no error with any of them.
+    double reference_seconds;
+    s.lights.build(light_sampler_type::bvh);
+    auto reference = render_pixels(s.cam, s, reference_spp, 7919, reference_seconds);
+
+    std::printf("scene: %d\n", config.scene_id);
+    std::printf("lights: %zu\n", s.lights.size());
+    std::printf("image_width: %d\n", config.image_width);
+    std::printf("spp: %d\n", spp);
+    std::printf("runs: %d\n", runs);
+    std::printf("reference_spp: %d\n\n", reference_spp);
+
+    for (const auto& named : samplers)
+    {
+        if (!selected(named))
+            continue;
+
+        // A few renders under different seeds: their errors are steadier than one image's,
+        // and the fastest is the least disturbed by other work.
+        s.lights.build(named.type);
+        double seconds = 0, mse = 0, median = 0;
+        for (int run = 0; run < runs; run++)
+        {
+            double run_seconds, run_mse, run_median;
+            auto image = render_pixels(s.cam, s, spp, run, run_seconds);
+            squared_errors(image, reference, run_mse, run_median);
+            mse += run_mse / runs;
+            median += run_median / runs;
+            seconds = run == 0 ? run_seconds : std::min(seconds, run_seconds);
+        }
+
+        std::printf("light_sampler: %s\n", named.name.c_str());
+        std::printf("seconds: %.3f\n", seconds);
+        std::printf("rmse: %.5f\n", std::sqrt(mse));
+        std::printf("rmse_x_seconds: %.5f\n", std::sqrt(mse) * seconds);
+        std::printf("mse_x_seconds: %.4e\n", mse * seconds);
+        std::printf("median_squared_error_x_seconds: %.4e\n\n", median * seconds);
+    }
+    return 0;
+}
\ No newline at end of file
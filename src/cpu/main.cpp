@@ -1,94 +1,468 @@
 #include "rtweekend.h"
 
-#include "bvh.h"
-#include "camera.h"
-#include "hittable.h"
-#include "hittable_list.h"
-#include "material.h"
-#include "sphere.h"
+#include "accumulation.h"
+#include "batch.h"
+#include "budget.h"
+#include "distributed.h"
+#include "net.h"
+#include "perf_counters.h"
+#include "render_session.h"
+#include "scene.h"
+#include "server.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <string>
 
-int main()
+void print_render_time(std::chrono::milliseconds ms)
 {
-    hittable_list world;
+    std::clog << "Render time: " << std::chrono::duration_cast<std::chrono::hours>(ms).count()
+              << 'h' << std::chrono::duration_cast<std::chrono::minutes>(ms).count() % 60 << 'm'
+              << std::chrono::duration_cast<std::chrono::seconds>(ms).count() % 60 << 's'
+              << std::endl;
+}
 
-    // Construct world
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
+void print_usage()
+{
+    std::cerr << "Usage: cpu_pt [options] > image.ppm\n"
+                 "  --scene <n>              1 = bouncing spheres (default), 2 = glowing spheres,\n"
+                 "                           3 = sphere field, 4 = moving spheres,\n"
+                 "                           5 = sphere field with one sphere in eight glowing,\n"
+                 "                           6 = field of long thin quads\n"
+                 "  --primitives <n>         Sphere fields: number of spheres (default 1000000);\n"
+                 "                           quad field: number of quads (default 100000)\n"
+                 "  --accel <type>           bvh (default), compact: quantized 4-wide BVH,\n"
+                 "                           sbvh: compact with spatial splits, lbvh: compact\n"
+                 "                           built from Morton codes, or lbvh-sah: lbvh with\n"
+                 "                           treelets restructured\n"
+                 "  --node-layout <order>    Compact/SBVH node order: depth (default), treelet\n"
+                 "                           or frequency, treelets from a profile render\n"
+                 "  --light-sampler <type>   Scenes 2 and 5: how next-event estimation picks\n"
+                 "                           a light: bvh (default), uniform or power\n"
+                 "  --perf-counters          Report cache miss rates and path throughput, and\n"
+                 "                           traversal counts in TRAVERSAL_STATS builds\n"
+                 "  --width <px>             Override the image width\n"
+                 "  --spp <n>                Override the samples per pixel\n"
+                 "  --seed <n>               Sampler seed (default 0)\n"
+                 "  --ray-batch <n>          Trace n path samples together, sorting secondary\n"
+                 "                           rays by origin and direction (default 0: off)\n"
+                 "  --aspect <ratio>         Override the aspect ratio\n"
+                 "  --lookfrom <x,y,z>       Override the camera position (with --lookat)\n"
+                 "  --lookat <x,y,z>         Override the point the camera looks at\n"
+                 "  --vfov <degrees>         Override the vertical field of view\n"
+                 "  --shutter <open>:<close> Override the shutter interval, within the frame\n"
+                 "                           interval 0:1; 0:0 freezes motion\n"
+                 "  --views <file>           Render every view in file, one per line as\n"
+                 "                           lookfrom lookat [vfov], e.g. 13,2,3 0,0,0 20\n"
+                 "  --out <prefix>           Views: write <prefix><n>.ppm (default view_)\n"
+                 "  --budget <s>             Render for s seconds, noisiest tiles first; --spp\n"
+                 "                           caps the samples of any pixel\n"
+                 "  --spp-map <file>         Budget: write the samples taken per pixel as PGM\n"
+                 "  --samples <begin>:<end>  Render only samples [begin, end) of every pixel\n"
+                 "  --accum-out <file>       Write unnormalized sums and sample counts for\n"
+                 "                           pt_merge instead of an image ('-' for stdout)\n"
+                 "  --coordinator <endpoint> Distribute tiles to workers connecting to endpoint\n"
+                 "  --worker <endpoint>      Render tiles for the coordinator at endpoint\n"
+                 "  --local-workers <n>      Coordinator: fork n workers on this machine\n"
+                 "  --tile-size <px>         Tile edge length (default 32)\n"
+                 "  --late-after <s>         Coordinator: duplicate a tile still out after s\n"
+                 "                           seconds onto an idle worker (30)\n"
+                 "  --stall-after <s>        Coordinator: drop a worker that stops for s seconds\n"
+                 "                           in the middle of a message (5)\n"
+                 "  --serve <endpoint>       Run a render server that keeps scenes in memory\n"
+                 "  --cache-scenes <n>       Serve: scenes kept in memory between jobs (4)\n"
+                 "  --submit <endpoint>      Render on a server and write the image\n"
+                 "  --passes <n>             Submit: progressive updates to stream (default 8)\n"
+                 "Endpoints are unix:/path/to/socket or host:port.\n";
+}
+
+bool parse_vec3(const char* text, double v[3])
+{
+    return std::sscanf(text, "%lf,%lf,%lf", &v[0], &v[1], &v[2]) == 3;
+}
 
-    for (int a = -11; a < 11; a++)
+bool read_views(const std::string& path, const render_config& base,
+                std::vector<render_config>& views)
+{
+    // Every non-empty line not starting with '#' is one view of the scene in `base`.
+    std::ifstream in(path);
+    if (!in)
+        return false;
+
+    std::string line;
+    while (std::getline(in, line))
     {
-        for (int b = -11; b < 11; b++)
-        {
-            auto choose_mat = random_double();
-            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        char from[128], at[128];
+        double vfov;
+        int fields = std::sscanf(line.c_str(), "%127s %127s %lf", from, at, &vfov);
+        render_config view = base;
+        if (fields < 2 || !parse_vec3(from, view.lookfrom) || !parse_vec3(at, view.lookat))
+            return false;
+
+        view.has_view = 1;
+        if (fields == 3)
+            view.vfov = vfov;
+        views.push_back(view);
+    }
+    return !views.empty();
+}
 
-            if ((center - point3(4, 0.2, 0)).length() > 0.9)
+int main(int argc, char* argv[])
+{
+    render_config config;
+    std::string coordinator_endpoint, worker_endpoint, serve_endpoint, submit_endpoint;
+    render_job job;
+    coordinator coord;
+    render_server server;
+    int sample_begin = 0, sample_end = -1;
+    std::string accum_path;
+    std::string views_path, out_prefix = "view_";
+    budget_renderer budget;
+    budget.seconds = 0;
+    std::string spp_map_path;
+    bool report_counters = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        auto arg = std::string(argv[i]);
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--scene" && has_value)
+            config.scene_id = std::atoi(argv[++i]);
+        else if (arg == "--primitives" && has_value)
+            config.primitive_count = std::atoi(argv[++i]);
+        else if (arg == "--accel" && has_value)
+        {
+            auto type = std::string(argv[++i]);
+            if (type == "bvh")
+                config.accel = int32_t(accel_type::bvh);
+            else if (type == "compact")
+                config.accel = int32_t(accel_type::compact);
+            else if (type == "sbvh")
+                config.accel = int32_t(accel_type::sbvh);
+            else if (type == "lbvh")
+                config.accel = int32_t(accel_type::lbvh);
+            else if (type == "lbvh-sah")
+                config.accel = int32_t(accel_type::lbvh_sah);
+            else
+            {
+                print_usage();
+                return 1;
+            }
+        }
+        else if (arg == "--node-layout" && has_value)
+        {
+            auto order = std::string(argv[++i]);
+            if (order == "depth")
+                config.node_layout = int32_t(node_layout::depth_first);
+            else if (order == "treelet")
+                config.node_layout = int32_t(node_layout::treelet);
+            else if (order == "frequency")
+                config.node_layout = int32_t(node_layout::frequency);
+            else
             {
-                shared_ptr<material> sphere_material;
-
-                if (choose_mat < 0.8)
-                {
-                    // diffuse
-                    auto albedo = color::random() * color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else if (choose_mat < 0.95)
-                {
-                    // metal
-                    auto albedo = color::random(0.5, 1);
-                    auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else
-                {
-                    // glass
-                    sphere_material = make_shared<dielectric>(1.5);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
+                print_usage();
+                return 1;
             }
         }
+        else if (arg == "--light-sampler" && has_value)
+        {
+            auto type = std::string(argv[++i]);
+            if (type == "bvh")
+                config.light_sampler = int32_t(light_sampler_type::bvh);
+            else if (type == "uniform")
+                config.light_sampler = int32_t(light_sampler_type::uniform);
+            else if (type == "power")
+                config.light_sampler = int32_t(light_sampler_type::power);
+            else
+            {
+                print_usage();
+                return 1;
+            }
+        }
+        else if (arg == "--perf-counters")
+            report_counters = true;
+        else if (arg == "--width" && has_value)
+            config.image_width = std::atoi(argv[++i]);
+        else if (arg == "--spp" && has_value)
+            config.samples_per_pixel = std::atoi(argv[++i]);
+        else if (arg == "--seed" && has_value)
+            config.seed = std::atoi(argv[++i]);
+        else if (arg == "--ray-batch" && has_value)
+            config.ray_batch = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--aspect" && has_value)
+            config.aspect_ratio = std::atof(argv[++i]);
+        else if (arg == "--lookfrom" && has_value && parse_vec3(argv[++i], config.lookfrom))
+            config.has_view = 1;
+        else if (arg == "--lookat" && has_value && parse_vec3(argv[++i], config.lookat))
+            config.has_view = 1;
+        else if (arg == "--vfov" && has_value)
+            config.vfov = std::atof(argv[++i]);
+        else if (arg == "--shutter" && has_value)
+        {
+            if (std::sscanf(argv[++i], "%lf:%lf", &config.shutter[0], &config.shutter[1]) != 2 ||
+                config.shutter[0] < 0 || config.shutter[1] > 1 ||
+                config.shutter[1] < config.shutter[0])
+            {
+                print_usage();
+                return 1;
+            }
+            config.has_shutter = 1;
+        }
+        else if (arg == "--views" && has_value)
+            views_path = argv[++i];
+        else if (arg == "--out" && has_value)
+            out_prefix = argv[++i];
+        else if (arg == "--budget" && has_value)
+            budget.seconds = std::atof(argv[++i]);
+        else if (arg == "--spp-map" && has_value)
+            spp_map_path = argv[++i];
+        else if (arg == "--samples" && has_value)
+        {
+            if (std::sscanf(argv[++i], "%d:%d", &sample_begin, &sample_end) != 2 ||
+                sample_begin < 0 || sample_end <= sample_begin)
+            {
+                print_usage();
+                return 1;
+            }
+        }
+        else if (arg == "--accum-out" && has_value)
+            accum_path = argv[++i];
+        else if (arg == "--coordinator" && has_value)
+            coordinator_endpoint = argv[++i];
+        else if (arg == "--worker" && has_value)
+            worker_endpoint = argv[++i];
+        else if (arg == "--serve" && has_value)
+            serve_endpoint = argv[++i];
+        else if (arg == "--cache-scenes" && has_value)
+            server.max_scenes = size_t(std::max(0, std::atoi(argv[++i])));
+        else if (arg == "--submit" && has_value)
+            submit_endpoint = argv[++i];
+        else if (arg == "--passes" && has_value)
+            job.passes = std::atoi(argv[++i]);
+        else if (arg == "--local-workers" && has_value)
+            coord.local_workers = std::atoi(argv[++i]);
+        else if (arg == "--tile-size" && has_value)
+            coord.tile_size = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--late-after" && has_value)
+            coord.late_after_seconds = std::atof(argv[++i]);
+        else if (arg == "--stall-after" && has_value)
+            coord.stall_seconds = std::atof(argv[++i]);
+        else
+        {
+            print_usage();
+            return 1;
+        }
     }
 
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+    if (!worker_endpoint.empty())
+    {
+        endpoint ep;
+        if (!endpoint::parse(worker_endpoint, ep))
+        {
+            print_usage();
+            return 1;
+        }
+        return run_worker(ep);
+    }
 
-    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+    if (!serve_endpoint.empty() || !submit_endpoint.empty())
+    {
+        endpoint ep;
+        if (!endpoint::parse(serve_endpoint.empty() ? submit_endpoint : serve_endpoint, ep))
+        {
+            print_usage();
+            return 1;
+        }
 
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+        if (!serve_endpoint.empty())
+            return server.serve(ep);
 
-    world = hittable_list(make_shared<bvh_node>(world));
+        job.config = config;
+        return submit_job(ep, job);
+    }
 
-    // Set up camera
-    camera cam;
+    if (!coordinator_endpoint.empty())
+    {
+        endpoint ep;
+        if (!endpoint::parse(coordinator_endpoint, ep))
+        {
+            print_usage();
+            return 1;
+        }
 
-    cam.aspect_ratio = 16.0 / 9.0;
-    cam.image_width = 1200;
-    cam.samples_per_pixel = 500;
-    cam.max_depth = 50;
+        auto start_time = std::chrono::high_resolution_clock::now();
+        int status = coord.run(ep, config);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        print_render_time(
+            std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time));
+        return status;
+    }
 
-    cam.vfov = 20;
-    cam.lookfrom = point3(13, 2, 3);
-    cam.lookat = point3(0, 0, 0);
-    cam.vup = vec3(0, 1, 0);
+    if (!views_path.empty())
+    {
+        // Batch render: build the scene once and render every view against it.
+        std::vector<render_config> views;
+        if (!read_views(views_path, config, views))
+        {
+            std::cerr << "Could not read views from " << views_path << '\n';
+            return 1;
+        }
+
+        scene s = build_scene(config);
+        std::vector<camera> cams(views.size(), s.cam);
+        for (size_t v = 0; v < views.size(); v++)
+            configure_camera(cams[v], views[v]);
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        auto images = render_views(cams, s.world, s.lights, coord.tile_size);
+        auto end_time = std::chrono::high_resolution_clock::now();
+
+        for (size_t v = 0; v < views.size(); v++)
+        {
+            char name[32];
+            std::snprintf(name, sizeof(name), "%03zu.ppm", v);
+            std::ofstream out(out_prefix + name);
+            out << "P3\n" << cams[v].image_width << ' ' << cams[v].get_image_height()
+                << "\n255\n";
+            for (const auto& pixel_color : images[v])
+                write_color(out, pixel_color);
+        }
+
+        print_render_time(
+            std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time));
+        return 0;
+    }
+
+    // Opened before the scene is built, so that the render's worker threads inherit them.
+    perf_counters counters;
+
+    scene s = make_scene(config);
+
+    if (budget.seconds > 0)
+    {
+        budget.tile_size = coord.tile_size;
+        auto result = budget.render(s.cam, s.world, s.lights);
+
+        std::cout << "P3\n" << result.image_width << ' ' << result.image_height << "\n255\n";
+        for (const auto& pixel_color : result.image)
+            write_color(std::cout, pixel_color);
+
+        if (!spp_map_path.empty())
+        {
+            std::ofstream out(spp_map_path);
+            int max_spp = *std::max_element(result.spp.begin(), result.spp.end());
+            out << "P2\n" << result.image_width << ' ' << result.image_height << '\n'
+                << std::max(max_spp, 1) << '\n';
+            for (auto spp : result.spp)
+                out << spp << '\n';
+        }
+
+        auto total = std::accumulate(result.spp.begin(), result.spp.end(), 0.0);
+        std::clog << "Average samples per pixel: " << total / result.spp.size() << '\n';
+        print_render_time(std::chrono::milliseconds(int64_t(result.seconds * 1000)));
+        return 0;
+    }
+
+    if (sample_end >= 0 || !accum_path.empty())
+    {
+        // Sample-range render: accumulate samples [sample_begin, sample_end) of the frame.
+        s.cam.initialize();
+        int image_width = s.cam.image_width;
+        int image_height = s.cam.get_image_height();
+        if (sample_end < 0)
+            sample_end = s.cam.samples_per_pixel;
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        std::vector<color> sums(size_t(image_width) * image_height);
+        render_tile_parallel(s.cam, s.world, s.lights, tile(0, 0, image_width, image_height),
+                             sample_begin, sample_end, sums.data());
+        auto end_time = std::chrono::high_resolution_clock::now();
+
+        accumulation_buffer accum(image_width, image_height);
+        for (size_t i = 0; i < sums.size(); i++)
+            accum.add(i, sums[i], uint32_t(sample_end - sample_begin));
+
+        if (accum_path == "-")
+        {
+            accum.write(std::cout);
+        }
+        else if (!accum_path.empty())
+        {
+            std::ofstream out(accum_path, std::ios::binary);
+            accum.write(out);
+            if (!out.flush())
+            {
+                std::cerr << "cpu_pt: could not write " << accum_path << '\n';
+                return 1;
+            }
+        }
+        else
+        {
+            accum.write_image(std::cout);
+        }
+
+        print_render_time(
+            std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time));
+        return 0;
+    }
+
+    render_session session(std::make_shared<const scene>(std::move(s)), config);
+    session.tile_size = coord.tile_size;
+    session.on_tile = [](const tile&, size_t tiles_done, size_t tiles_total)
+    { std::clog << "\rTiles remaining: " << (tiles_total - tiles_done) << ' ' << std::flush; };
 
-    cam.defocus_angle = 0.6;
-    cam.focus_dist = 10.0;
+    int image_width = session.image_width();
+    int image_height = session.image_height();
+    std::vector<color> image(size_t(image_width) * image_height);
 
-    // Render
     auto start_time = std::chrono::high_resolution_clock::now();
-    cam.render(world);
+    traversal_stats::reset();
+    counters.start();
+    session.render(image.data());
+    counters.stop();
     auto end_time = std::chrono::high_resolution_clock::now();
+    std::clog << "\rDone.                 \n";
+
+    if (report_counters)
+    {
+        double seconds = std::chrono::duration<double>(end_time - start_time).count();
+        double paths = double(image_width) * image_height * session.samples_per_pixel();
+        std::clog << "Paths per second: " << paths / seconds << '\n';
+        if (TRAVERSAL_STATS)
+        {
+            auto counts = traversal_stats::total();
+            double rays = double(std::max<uint64_t>(counts.rays, 1));
+            std::clog << "Rays: " << counts.rays << ", nodes visited per ray: "
+                      << counts.nodes / rays << ", primitives tested per ray: "
+                      << counts.primitives / rays << '\n';
+        }
+        if (counters.available())
+        {
+            std::clog << "L1D read miss rate: "
+                      << counters.miss_rate(perf_counters::l1d_read_misses,
+                                            perf_counters::l1d_reads)
+                      << "\nLLC read miss rate: "
+                      << counters.miss_rate(perf_counters::llc_read_misses,
+                                            perf_counters::llc_reads)
+                      << '\n';
+        }
+        else
+        {
+            std::clog << "Cache counters are unavailable on this system\n";
+        }
+    }
 
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+    std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+    for (const auto& pixel_color : image)
+        write_color(std::cout, pixel_color);
 
-    std::clog << "Render time: " << std::chrono::duration_cast<std::chrono::hours>(ms).count()
-              << 'h' << std::chrono::duration_cast<std::chrono::minutes>(ms).count() % 60 << 'm'
-              << std::chrono::duration_cast<std::chrono::seconds>(ms).count() % 60 << 's'
-              << std::endl;
+    print_render_time(std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time));
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define MATERIAL_H
 
 #include "hittable.h"
+#include "onb.h"
+#include "sampler.h"
 
 class material
 {
@@ -9,10 +11,29 @@ class material
     virtual ~material() = default;
 
     virtual bool scatter(const ray& r_in, const hit_record& rec, color& attenuation,
-                         ray& scattered) const
+                         ray& scattered, sampler& smp) const
     {
         return false;
     }
+
+    virtual color emitted(const ray& r_in, const hit_record& rec) const { return color(0, 0, 0); }
+
+    // Radiance leaving the front face of an emitter, used to estimate its total power.
+    virtual color emission() const { return color(0, 0, 0); }
+
+    // BSDF evaluation for explicit light sampling. `eval` returns the BSDF times the cosine
+    // term for the incident direction `wi`, and `scattering_pdf` the solid angle density with
+    // which scatter() would have produced `wi`. Specular materials keep the zero defaults and
+    // are skipped by next-event estimation.
+    virtual color eval(const ray& r_in, const hit_record& rec, const vec3& wi) const
+    {
+        return color(0, 0, 0);
+    }
+
+    virtual double scattering_pdf(const ray& r_in, const hit_record& rec, const vec3& wi) const
+    {
+        return 0;
+    }
 };
 
 class lambertian : public material
@@ -21,19 +42,31 @@ class lambertian : public material
     lambertian(const color& albedo) : albedo(albedo) {}
 
     bool scatter(const ray& r_in, const hit_record& rec, color& attenuation,
-                 ray& scattered) const override
+                 ray& scattered, sampler& smp) const override
     {
-        auto scatter_direction = rec.normal + random_unit_vector();
-
-        // Catch degenerate scatter direction
-        if (scatter_direction.near_zero())
-            scatter_direction = rec.normal;
+        // Cosine-weighted hemisphere sample around the normal. The pdf cancels the cosine term
+        // of the Lambertian BRDF, leaving the albedo as the sample weight.
+        onb uvw(rec.normal);
+        auto u = smp.get_2d();
+        auto scatter_direction = uvw.transform(sample_cosine_hemisphere(u[0], u[1]));
 
-        scattered = ray(rec.p, scatter_direction);
+        scattered = rec.spawn_ray(scatter_direction, r_in.time(), true);
         attenuation = albedo;
         return true;
     }
 
+    color eval(const ray& r_in, const hit_record& rec, const vec3& wi) const override
+    {
+        auto cos_theta = dot(rec.normal, unit_vector(wi));
+        return cos_theta > 0 ? (albedo / pi) * cos_theta : color(0, 0, 0);
+    }
+
+    double scattering_pdf(const ray& r_in, const hit_record& rec, const vec3& wi) const override
+    {
+        auto cos_theta = dot(rec.normal, unit_vector(wi));
+        return cos_theta > 0 ? cosine_hemisphere_pdf(cos_theta) : 0;
+    }
+
   private:
     color albedo;
 };
@@ -44,11 +77,12 @@ class metal : public material
     metal(const color& albedo, double fuzz) : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1) {}
 
     bool scatter(const ray& r_in, const hit_record& rec, color& attenuation,
-                 ray& scattered) const override
+                 ray& scattered, sampler& smp) const override
     {
         vec3 reflected = reflect(r_in.direction(), rec.normal);
-        reflected = unit_vector(reflected) + (fuzz * random_unit_vector());
-        scattered = ray(rec.p, reflected);
+        auto u = smp.get_2d();
+        reflected = unit_vector(reflected) + (fuzz * sample_uniform_sphere(u[0], u[1]));
+        scattered = rec.spawn_ray(reflected, r_in.time());
         attenuation = albedo;
         return (dot(scattered.direction(), rec.normal) > 0);
     }
@@ -64,7 +98,7 @@ class dielectric : public material
     dielectric(double refraction_index) : refraction_index(refraction_index) {}
 
     bool scatter(const ray& r_in, const hit_record& rec, color& attenuation,
-                 ray& scattered) const override
+                 ray& scattered, sampler& smp) const override
     {
         attenuation = color(1.0, 1.0, 1.0);
         double ri = rec.front_face ? (1.0 / refraction_index) : refraction_index;
@@ -76,12 +110,12 @@ class dielectric : public material
         bool cannot_refract = ri * sin_theta > 1.0;
         vec3 direction;
 
-        if (cannot_refract || reflectance(cos_theta, ri) > random_double())
+        if (cannot_refract || reflectance(cos_theta, ri) > smp.get_1d())
             direction = reflect(unit_direction, rec.normal);
         else
             direction = refract(unit_direction, rec.normal, ri);
 
-        scattered = ray(rec.p, direction);
+        scattered = rec.spawn_ray(direction, r_in.time(), true);
         return true;
     }
 
@@ -99,4 +133,23 @@ class dielectric : public material
     }
 };
 
+class diffuse_light : public material
+{
+  public:
+    diffuse_light(const color& emit) : emit(emit) {}
+
+    color emitted(const ray& r_in, const hit_record& rec) const override
+    {
+        // Emits from the outward-facing side only.
+        if (!rec.front_face)
+            return color(0, 0, 0);
+        return emit;
+    }
+
+    color emission() const override { return emit; }
+
+  private:
+    color emit;
+};
+
 #endif
\ No newline at end of file
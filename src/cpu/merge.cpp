@@ -0,0 +1,129 @@
+#include "rtweekend.h"
+
+#include "accumulation.h"
+
+#include <algorithm>
+#include <execution>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// Sums any number of accumulation buffers written by `cpu_pt --accum-out` into the final
+// image, and optionally into a merged accumulation buffer that more samples can be added to
+// later. The inputs are streamed block by block, with every file read in parallel, so
+// merging never holds more than one block per input in memory.
+
+int main(int argc, char* argv[])
+{
+    std::string merged_path;
+    std::vector<std::string> input_paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        auto arg = std::string(argv[i]);
+        if (arg == "--accum-out" && i + 1 < argc)
+            merged_path = argv[++i];
+        else if (arg.rfind("--", 0) != 0)
+            input_paths.push_back(arg);
+        else
+        {
+            input_paths.clear();
+            break;
+        }
+    }
+
+    if (input_paths.empty())
+    {
+        std::cerr << "Usage: pt_merge [--accum-out merged.acc] a.acc b.acc ... > image.ppm\n";
+        return 1;
+    }
+
+    int width = 0, height = 0;
+    std::vector<std::unique_ptr<std::ifstream>> inputs;
+    for (const auto& path : input_paths)
+    {
+        auto in = std::make_unique<std::ifstream>(path, std::ios::binary);
+        int w, h;
+        if (!*in || !accumulation_buffer::read_header(*in, w, h))
+        {
+            std::cerr << "pt_merge: " << path << " is not an accumulation buffer\n";
+            return 1;
+        }
+        if (inputs.empty())
+        {
+            width = w;
+            height = h;
+        }
+        else if (w != width || h != height)
+        {
+            std::cerr << "pt_merge: " << path << " is " << w << 'x' << h << ", expected "
+                      << width << 'x' << height << '\n';
+            return 1;
+        }
+        inputs.push_back(std::move(in));
+    }
+
+    std::ofstream merged;
+    if (!merged_path.empty())
+    {
+        merged.open(merged_path, std::ios::binary);
+        accumulation_buffer::write_header(merged, width, height);
+    }
+
+    std::cout << "P3\n" << width << ' ' << height << "\n255\n";
+
+    const size_t pixel_count = size_t(width) * height;
+    const size_t block_size = size_t(1) << 16;
+    std::vector<std::vector<accum_pixel>> blocks(inputs.size(),
+                                                 std::vector<accum_pixel>(block_size));
+    std::vector<size_t> file_index(inputs.size());
+    std::iota(file_index.begin(), file_index.end(), 0);
+    std::vector<char> read_ok(inputs.size()); // Per file, so that no two threads share a flag
+    accumulation_buffer sum(int(block_size), 1);
+
+    for (size_t start = 0; start < pixel_count; start += block_size)
+    {
+        size_t count = std::min(block_size, pixel_count - start);
+
+        std::for_each(std::execution::par, file_index.begin(), file_index.end(),
+                      [&](size_t f)
+                      {
+                          auto bytes = std::streamsize(count * sizeof(accum_pixel));
+                          read_ok[f] = bool(
+                              inputs[f]->read(reinterpret_cast<char*>(blocks[f].data()), bytes));
+                      });
+
+        if (std::find(read_ok.begin(), read_ok.end(), 0) != read_ok.end())
+        {
+            std::cerr << "pt_merge: input ended early\n";
+            return 1;
+        }
+
+        // Add the inputs in command-line order so the result doesn't depend on scheduling.
+        std::fill(sum.pixels.begin(), sum.pixels.begin() + count, accum_pixel{});
+        for (const auto& block : blocks)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                const auto& p = block[i];
+                sum.add(i, color(p.sum[0], p.sum[1], p.sum[2]), p.count);
+            }
+        }
+
+        if (merged.is_open())
+            merged.write(reinterpret_cast<const char*>(sum.pixels.data()),
+                         std::streamsize(count * sizeof(accum_pixel)));
+
+        for (size_t i = 0; i < count; i++)
+            write_color(std::cout, sum.average(i));
+    }
+
+    if (merged.is_open() && !merged.flush())
+    {
+        std::cerr << "pt_merge: could not write " << merged_path << '\n';
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,214 @@
+#ifndef NET_H
+#define NET_H
+
+// Minimal POSIX socket helpers for the distributed renderer. Endpoints are written either
+// as "unix:/path/to/socket" or as "host:port" for TCP.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <netdb.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+class endpoint
+{
+  public:
+    bool is_unix = false;
+    std::string path; // Unix socket path
+    std::string host; // TCP host name or address; empty listens on every interface
+    std::string port; // TCP port
+
+    static bool parse(const std::string& spec, endpoint& out)
+    {
+        out = endpoint();
+        if (spec.rfind("unix:", 0) == 0)
+        {
+            out.is_unix = true;
+            out.path = spec.substr(5);
+            return !out.path.empty();
+        }
+
+        auto colon = spec.rfind(':');
+        if (colon == std::string::npos)
+        {
+            out.port = spec;
+        }
+        else
+        {
+            out.host = spec.substr(0, colon);
+            out.port = spec.substr(colon + 1);
+        }
+        return !out.port.empty();
+    }
+};
+
+inline int open_listener(const endpoint& ep)
+{
+    // Returns a listening socket, or -1 on failure.
+    if (ep.is_unix)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, ep.path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(ep.path.c_str());
+
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+            listen(fd, SOMAXCONN) < 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    addrinfo* results = nullptr;
+    const char* host = ep.host.empty() ? nullptr : ep.host.c_str();
+    if (getaddrinfo(host, ep.port.c_str(), &hints, &results) != 0)
+        return -1;
+
+    int fd = -1;
+    for (auto* ai = results; ai; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0)
+            break;
+
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(results);
+    return fd;
+}
+
+inline int open_connection(const endpoint& ep)
+{
+    // Returns a connected socket, or -1 on failure.
+    if (ep.is_unix)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, ep.path.c_str(), sizeof(addr.sun_path) - 1);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* results = nullptr;
+    const char* host = ep.host.empty() ? "localhost" : ep.host.c_str();
+    if (getaddrinfo(host, ep.port.c_str(), &hints, &results) != 0)
+        return -1;
+
+    int fd = -1;
+    for (auto* ai = results; ai; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(results);
+    return fd;
+}
+
+inline bool set_receive_timeout(int fd, double seconds)
+{
+    // Makes a receive that waits longer than `seconds` for data fail with EAGAIN, so that a
+    // peer that stops sending halfway through a message cannot block the reader for good.
+    timeval tv{};
+    tv.tv_sec = time_t(seconds);
+    tv.tv_usec = suseconds_t((seconds - double(tv.tv_sec)) * 1e6);
+    return setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0;
+}
+
+inline bool send_all(int fd, const void* data, size_t size)
+{
+    auto bytes = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        auto n = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        bytes += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+inline bool recv_all(int fd, void* data, size_t size)
+{
+    auto bytes = static_cast<char*>(data);
+    while (size > 0)
+    {
+        auto n = recv(fd, bytes, size, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        bytes += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+// Messages are a fixed header followed by `size` bytes of payload. Both ends run the same
+// binary, so payloads are plain structs in native byte order.
+
+struct message_header
+{
+    uint32_t type;
+    uint32_t size;
+};
+
+inline bool send_message(int fd, uint32_t type, const void* payload, size_t size)
+{
+    message_header header{type, uint32_t(size)};
+    return send_all(fd, &header, sizeof(header)) && (size == 0 || send_all(fd, payload, size));
+}
+
+inline bool recv_message(int fd, uint32_t& type, std::vector<char>& payload)
+{
+    message_header header;
+    if (!recv_all(fd, &header, sizeof(header)))
+        return false;
+
+    type = header.type;
+    payload.resize(header.size);
+    return header.size == 0 || recv_all(fd, payload.data(), header.size);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include "rtweekend.h"
+
+#include "scene.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Simulates the caches and TLB that compact BVH traversal runs through, for comparing node
+// layouts on machines whose hardware counters are out of reach. The rays of a small render of
+// the scene are recorded once, then replayed against the scene's compact BVH in each layout,
+// in image order or shuffled, and the address of every node visited is fed to a model of a
+// 32 KB 8-way L1, a 1 MB 16-way L2 behind it and a 64-entry 4-way TLB of 4 KB pages, all with
+// least recently used replacement. Only node fetches are modeled; primitives are not. Every
+// figure is printed as one `key: value` line, as bvh_stats does.
+
+class cache_model
+{
+  public:
+    // A set-associative cache of `bytes` in lines of 2^line_bits bytes, tracking tags only.
+
+    cache_model(size_t bytes, int ways, int line_bits)
+        : ways(ways), line_bits(line_bits), sets((bytes >> line_bits) / ways),
+          tags(sets * ways, empty)
+    {
+    }
+
+    bool access(uint64_t address)
+    {
+        // Returns whether the access missed. Each set keeps its tags most recent first.
+        uint64_t tag = address >> line_bits;
+        auto set = tags.begin() + (tag % sets) * ways;
+        accesses++;
+
+        auto it = std::find(set, set + ways, tag);
+        bool miss = it == set + ways;
+        if (miss)
+        {
+            misses++;
+            it = set + ways - 1;
+        }
+        std::rotate(set, it, it + 1);
+        *set = tag;
+        return miss;
+    }
+
+    double miss_percent() const { return accesses > 0 ? 100.0 * misses / accesses : 0.0; }
+
+    uint64_t accesses = 0;
+    uint64_t misses = 0;
+
+  private:
+    static constexpr uint64_t empty = ~uint64_t(0);
+
+    int ways;
+    int line_bits;
+    size_t sets;
+    std::vector<uint64_t> tags;
+};
+
+struct recorded_ray
+{
+    ray r;
+    interval ray_t;
+    bool any_hit; // Shadow ray: any hit ends the search
+};
+
+class ray_recorder : public hittable
+{
+  public:
+    // Traces through `world` and keeps a copy of every query, to replay against other layouts.
+    // Not thread-safe: trace through it from one thread.
+
+    mutable std::vector<recorded_ray> rays;
+
+    ray_recorder(const hittable& world) : world(world) {}
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override
+    {
+        rays.push_back({r, ray_t, false});
+        return world.hit(r, ray_t, rec);
+    }
+
+    bool occluded(const ray& r, interval ray_t) const override
+    {
+        rays.push_back({r, ray_t, true});
+        return world.occluded(r, ray_t);
+    }
+
+    aabb bounding_box() const override { return world.bounding_box(); }
+
+  private:
+    const hittable& world;
+};
+
+struct named_layout
+{
+    std::string name;
+    node_layout layout;
+};
+
+shared_ptr<compact_bvh> find_compact_bvh(const scene& s)
+{
+    for (const auto& object : s.world.objects)
+    {
+        if (auto bvh = std::dynamic_pointer_cast<compact_bvh>(object))
+            return bvh;
+    }
+    return nullptr;
+}
+
+int main(int argc, char* argv[])
+{
+    render_config config;
+    config.scene_id = 3;
+    config.accel = int32_t(accel_type::compact);
+    std::string layout_name = "all", order_name = "both";
+    int ray_width = 200;
+
+    for (int i = 1; i < argc; i++)
+    {
+        auto arg = std::string(argv[i]);
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--scene" && has_value)
+            config.scene_id = std::atoi(argv[++i]);
+        else if (arg == "--primitives" && has_value)
+            config.primitive_count = std::atoi(argv[++i]);
+        else if (arg == "--layout" && has_value)
+            layout_name = argv[++i];
+        else if (arg == "--order" && has_value)
+            order_name = argv[++i];
+        else if (arg == "--ray-width" && has_value)
+            ray_width = std::max(1, std::atoi(argv[++i]));
+        else
+        {
+            std::cerr
+                << "Usage: node_cache_sim [options]\n"
+                   "  --scene <n>          Scene to build, as for cpu_pt (default 3)\n"
+                   "  --primitives <n>     Sphere or quad fields: number of primitives\n"
+                   "  --layout <name>      depth, treelet, frequency or all (default)\n"
+                   "  --order <name>       Replay the rays in image order, shuffled, or both\n"
+                   "                       (default)\n"
+                   "  --ray-width <px>     Width of the render whose rays are replayed\n"
+                   "                       (default 200, 1 sample per pixel)\n";
+            return 1;
+        }
+    }
+
+    std::vector<named_layout> layouts = {
+        {"depth", node_layout::depth_first},
+        {"treelet", node_layout::treelet},
+        {"frequency", node_layout::frequency},
+    };
+    std::vector<std::string> orders;
+    if (order_name == "image" || order_name == "both")
+        orders.push_back("image");
+    if (order_name == "shuffled" || order_name == "both")
+        orders.push_back("shuffled");
+
+    auto selected = [&](const named_layout& named)
+    { return layout_name == "all" || layout_name == named.name; };
+    if (orders.empty() || std::none_of(layouts.begin(), layouts.end(), selected))
+    {
+        std::cerr << "node_cache_sim: unknown layout or order\n";
+        return 1;
+    }
+
+    // Every layout renders the same image, so one recording serves them all.
+    std::vector<recorded_ray> rays;
+    {
+        scene s = build_scene(config);
+        if (!find_compact_bvh(s))
+        {
+            std::cerr << "node_cache_sim: the scene has no primitives to build a BVH over\n";
+            return 1;
+        }
+
+        ray_recorder recorder(s.world);
+        camera cam = s.cam;
+        cam.image_width = ray_width;
+        cam.initialize();
+        std::vector<color> sums(size_t(cam.image_width) * cam.get_image_height());
+        cam.render_tile(recorder, s.lights, tile(0, 0, cam.image_width, cam.get_image_height()),
+                        0, 1, sums.data());
+        rays = std::move(recorder.rays);
+    }
+    auto shuffled = rays;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937_64(3));
+
+    std::printf("scene: %d\n", config.scene_id);
+    std::printf("rays: %zu\n\n", rays.size());
+
+    for (const auto& named : layouts)
+    {
+        if (!selected(named))
+            continue;
+
+        config.node_layout = int32_t(named.layout);
+        scene s = build_scene(config);
+        auto bvh = find_compact_bvh(s);
+
+        for (const auto& order : orders)
+        {
+            cache_model l1(32 << 10, 8, 6), l2(1 << 20, 16, 6), tlb(64 << 12, 4, 12);
+            auto fetch = [&](uint32_t i)
+            {
+                auto address = reinterpret_cast<uintptr_t>(bvh->node_address(i));
+                if (l1.access(address))
+                    l2.access(address);
+                tlb.access(address);
+            };
+
+            for (const auto& q : order == "image" ? rays : shuffled)
+            {
+                hit_record rec;
+                if (q.any_hit)
+                    bvh->occluded(q.r, q.ray_t, fetch);
+                else
+                    bvh->hit(q.r, q.ray_t, rec, fetch);
+            }
+
+            std::printf("layout: %s\n", named.name.c_str());
+            std::printf("order: %s\n", order.c_str());
+            std::printf("node_fetches: %llu\n", (unsigned long long)l1.accesses);
+            std::printf("l1_miss_percent: %.2f\n", l1.miss_percent());
+            std::printf("l2_miss_percent_of_l1_misses: %.2f\n", l2.miss_percent());
+            std::printf("tlb_miss_percent: %.2f\n\n", tlb.miss_percent());
+        }
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef ONB_H
+#define ONB_H
+
+class onb
+{
+  public:
+    onb(const vec3& n)
+    {
+        // Branchless construction from Duff et al., "Building an Orthonormal Basis, Revisited".
+        // NOTE: the parameter `n` is assumed to have unit length.
+        axis[2] = n;
+
+        double sign = std::copysign(1.0, n.z());
+        double a = -1.0 / (sign + n.z());
+        double b = n.x() * n.y() * a;
+
+        axis[0] = vec3(1.0 + sign * n.x() * n.x() * a, sign * b, -sign * n.x());
+        axis[1] = vec3(b, sign + n.y() * n.y() * a, -n.y());
+    }
+
+    const vec3& u() const { return axis[0]; }
+    const vec3& v() const { return axis[1]; }
+    const vec3& w() const { return axis[2]; }
+
+    vec3 transform(const vec3& v) const
+    {
+        // Transform from basis coordinates to local space.
+        return (v[0] * axis[0]) + (v[1] * axis[1]) + (v[2] * axis[2]);
+    }
+
+  private:
+    vec3 axis[3];
+};
+
+#endif
\ No newline at end of file
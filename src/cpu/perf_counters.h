@@ -0,0 +1,126 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// Hardware cache event counts for this process, read through Linux's perf_event_open. The
+// counters follow every thread created after they are opened, so open them before the first
+// parallel algorithm starts its worker threads. Elsewhere, or where the kernel or a virtual
+// machine does not expose the events, available() is false and every count reads 0.
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class perf_counters
+{
+  public:
+    enum event
+    {
+        l1d_reads,       // Level 1 data cache read accesses
+        l1d_read_misses, // ... that missed
+        llc_reads,       // Last level cache read accesses, which reach it past the L2
+        llc_read_misses, // ... that missed and went to memory
+        event_count
+    };
+
+    perf_counters()
+    {
+#ifdef __linux__
+        const uint64_t l1d = PERF_COUNT_HW_CACHE_L1D, llc = PERF_COUNT_HW_CACHE_LL;
+        const uint64_t read = uint64_t(PERF_COUNT_HW_CACHE_OP_READ) << 8;
+        const uint64_t access = uint64_t(PERF_COUNT_HW_CACHE_RESULT_ACCESS) << 16;
+        const uint64_t miss = uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16;
+        const uint64_t configs[event_count] = {l1d | read | access, l1d | read | miss,
+                                               llc | read | access, llc | read | miss};
+
+        for (int e = 0; e < event_count; e++)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = configs[e];
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[e] = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    ~perf_counters()
+    {
+#ifdef __linux__
+        for (int fd : fds)
+        {
+            if (fd >= 0)
+                close(fd);
+        }
+#endif
+    }
+
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+
+    bool available() const
+    {
+        for (int fd : fds)
+        {
+            if (fd < 0)
+                return false;
+        }
+        return true;
+    }
+
+    void start()
+    {
+#ifdef __linux__
+        for (int fd : fds)
+        {
+            if (fd >= 0)
+            {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    void stop()
+    {
+#ifdef __linux__
+        for (int fd : fds)
+        {
+            if (fd >= 0)
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+#endif
+    }
+
+    uint64_t count(event e) const
+    {
+        uint64_t value = 0;
+#ifdef __linux__
+        if (fds[e] >= 0 && read(fds[e], &value, sizeof(value)) != sizeof(value))
+            value = 0;
+#endif
+        return value;
+    }
+
+    double miss_rate(event misses, event accesses) const
+    {
+        auto n = count(accesses);
+        return n > 0 ? double(count(misses)) / n : 0;
+    }
+
+  private:
+    int fds[event_count] = {-1, -1, -1, -1};
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef PLANE_H
+#define PLANE_H
+
+#include "hittable.h"
+#include "material.h"
+#include "traversal_stats.h"
+
+class plane : public hittable
+{
+  public:
+    // The infinite plane through `point` facing along `normal`. Its bounds are the whole of
+    // space, so scenes keep it out of the BVH (see build_accelerator) and test it directly.
+    plane(const point3& point, const vec3& normal, shared_ptr<material> mat)
+        : normal(unit_vector(normal)), mat(mat)
+    {
+        D = dot(this->normal, point);
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override
+    {
+        COUNT_TRAVERSAL(primitives, 1);
+        double t;
+        if (!intersect(r, ray_t, t))
+            return false;
+
+        rec.t = t;
+        rec.p = project_to_plane(r.at(t), normal, D, rec.p_error);
+        rec.set_face_normal(r, normal);
+        rec.mat = mat;
+        rec.object = this;
+
+        return true;
+    }
+
+    bool occluded(const ray& r, interval ray_t) const override
+    {
+        COUNT_TRAVERSAL(primitives, 1);
+        double t;
+        return intersect(r, ray_t, t);
+    }
+
+    aabb bounding_box() const override { return aabb::universe; }
+
+  private:
+    vec3 normal;
+    double D; // dot(normal, p) for every point p of the plane
+    shared_ptr<material> mat;
+
+    bool intersect(const ray& r, interval ray_t, double& t) const
+    {
+        // No hit if the ray is parallel to the plane.
+        auto denom = dot(normal, r.direction());
+        if (std::fabs(denom) < 1e-8)
+            return false;
+
+        t = (D - dot(normal, r.origin())) / denom;
+        return ray_t.surrounds(t);
+    }
+};
+
+#endif
\ No newline at end of file
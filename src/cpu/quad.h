@@ -0,0 +1,143 @@
+#ifndef QUAD_H
+#define QUAD_H
+
+#include "hittable.h"
+#include "material.h"
+#include "traversal_stats.h"
+
+class quad : public hittable
+{
+  public:
+    // The parallelogram with corner Q and edges u and v.
+    quad(const point3& Q, const vec3& u, const vec3& v, shared_ptr<material> mat)
+        : Q(Q), u(u), v(v), mat(mat)
+    {
+        auto n = cross(u, v);
+        normal = unit_vector(n);
+        D = dot(normal, Q);
+        w = n / dot(n, n);
+
+        set_bounding_box();
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override
+    {
+        COUNT_TRAVERSAL(primitives, 1);
+        double t;
+        if (!intersect(r, ray_t, t))
+            return false;
+
+        rec.t = t;
+        rec.p = project_to_plane(r.at(t), normal, D, rec.p_error);
+        rec.set_face_normal(r, normal);
+        rec.mat = mat;
+        rec.object = this;
+
+        return true;
+    }
+
+    bool occluded(const ray& r, interval ray_t) const override
+    {
+        COUNT_TRAVERSAL(primitives, 1);
+        double t;
+        return intersect(r, ray_t, t);
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    aabb clipped_box(const aabb& region) const override
+    {
+        // Bounds of the parallelogram clipped to the region one axis plane at a time
+        // (Sutherland-Hodgman). Each plane adds at most one vertex to the four corners.
+        // Padded for rounding, and like the whole box where it is thin.
+        point3 polygon[10] = {Q, Q + u, Q + u + v, Q + v};
+        point3 clipped[10];
+        int count = 4;
+        for (int axis = 0; axis < 3 && count > 0; axis++)
+        {
+            const interval& ax = region.axis_interval(axis);
+            for (int side = 0; side < 2 && count > 0; side++)
+            {
+                double bound = side == 0 ? ax.min : ax.max;
+                auto inside = [&](const point3& p)
+                { return side == 0 ? p[axis] >= bound : p[axis] <= bound; };
+
+                int clipped_count = 0;
+                for (int i = 0; i < count; i++)
+                {
+                    const point3& a = polygon[i];
+                    const point3& b = polygon[(i + 1) % count];
+                    if (inside(a))
+                        clipped[clipped_count++] = a;
+                    if (inside(a) != inside(b))
+                    {
+                        point3 p = a + (bound - a[axis]) / (b[axis] - a[axis]) * (b - a);
+                        p[axis] = bound;
+                        clipped[clipped_count++] = p;
+                    }
+                }
+                std::copy(clipped, clipped + clipped_count, polygon);
+                count = clipped_count;
+            }
+        }
+        if (count == 0)
+            return aabb::empty;
+
+        aabb box(polygon[0], polygon[0]);
+        for (int i = 1; i < count; i++)
+            box = aabb(box, aabb(polygon[i], polygon[i]));
+        return padded(box, 1e-9 * (u.length() + v.length()));
+    }
+
+  private:
+    point3 Q;
+    vec3 u, v;
+    vec3 w; // Maps a point of the plane to its (alpha, beta) coordinates along u and v
+    vec3 normal;
+    double D;
+    shared_ptr<material> mat;
+    aabb bbox;
+
+    void set_bounding_box()
+    {
+        // Compute the bounding box of all four vertices.
+        bbox = padded(aabb(aabb(Q, Q + u + v), aabb(Q + u, Q + v)), 0);
+    }
+
+    static aabb padded(aabb box, double rounding)
+    {
+        // Widens every axis by `rounding`. A quad lying in an axis plane has a box of zero
+        // thickness, which the slab test never reports as hit, so thin axes are padded more.
+        double delta = 0.0001;
+        for (interval* ax : {&box.x, &box.y, &box.z})
+        {
+            *ax = ax->expand(2 * rounding);
+            if (ax->size() < delta)
+                *ax = ax->expand(delta);
+        }
+        return box;
+    }
+
+    bool intersect(const ray& r, interval ray_t, double& t) const
+    {
+        // No hit if the ray is parallel to the plane.
+        auto denom = dot(normal, r.direction());
+        if (std::fabs(denom) < 1e-8)
+            return false;
+
+        // Return false if the hit point parameter t is outside the ray interval.
+        t = (D - dot(normal, r.origin())) / denom;
+        if (!ray_t.surrounds(t))
+            return false;
+
+        // Determine if the hit point lies within the planar shape using its plane coordinates.
+        auto planar_hitpt_vector = r.at(t) - Q;
+        auto alpha = dot(w, cross(planar_hitpt_vector, v));
+        auto beta = dot(w, cross(u, planar_hitpt_vector));
+
+        interval unit_interval = interval(0, 1);
+        return unit_interval.contains(alpha) && unit_interval.contains(beta);
+    }
+};
+
+#endif
\ No newline at end of file
@@ -6,18 +6,47 @@
 class ray
 {
   public:
+    // Besides its origin and direction, a ray carries what every box test against it needs:
+    // the reciprocal of its direction and the sign of each component. They are computed once
+    // here instead of at each of the many BVH nodes the ray visits.
+
     ray() {}
 
-    ray(const point3& origin, const vec3& direction) : orig(origin), dir(direction) {}
+    ray(const point3& origin, const vec3& direction, double time = 0,
+        bool unit_direction = false)
+        : orig(origin), dir(direction),
+          inv_dir(1.0 / direction[0], 1.0 / direction[1], 1.0 / direction[2]), tm(time),
+          unit(unit_direction)
+    {
+        // The signs are read off the reciprocal, so that they agree with it for -0, whose
+        // reciprocal is -infinity.
+        for (int axis = 0; axis < 3; axis++)
+            negative[axis] = inv_dir[axis] < 0;
+    }
 
     const point3& origin() const { return orig; }
     const vec3& direction() const { return dir; }
+    const vec3& inv_direction() const { return inv_dir; }
+
+    // When, as a fraction [0, 1] of the frame interval, the ray looks at the scene. Moving
+    // primitives are intersected where they are at that time.
+    double time() const { return tm; }
+
+    // Whether the direction heads down `axis`.
+    bool is_negative(int axis) const { return negative[axis]; }
+
+    // Whether the direction was built with unit length, which its creator vouches for.
+    bool has_unit_direction() const { return unit; }
 
     point3 at(double t) const { return orig + t * dir; }
 
   private:
     point3 orig;
     vec3 dir;
+    vec3 inv_dir;
+    double tm = 0;
+    bool negative[3] = {false, false, false};
+    bool unit = false;
 };
 
 #endif
\ No newline at end of file
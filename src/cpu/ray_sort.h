@@ -0,0 +1,87 @@
+#ifndef RAY_SORT_H
+#define RAY_SORT_H
+
+// Sort keys for batches of incoherent rays. After the first bounce, rays leave their surfaces
+// in all directions and consecutive rays of a path tracer visit unrelated parts of the BVH.
+// Tracing a batch in key order instead makes neighbouring rays start in the same region and
+// head the same way, so they visit the same nodes and primitives while those are in cache.
+
+#include "aabb.h"
+#include "ray.h"
+
+#include <cstdint>
+#include <vector>
+
+inline uint32_t spread_bits_3d(uint32_t x)
+{
+    // Moves bit k of the low 10 bits of x to bit 3k.
+    x &= 0x3ff;
+    x = (x | x << 16) & 0x30000ff;
+    x = (x | x << 8) & 0x300f00f;
+    x = (x | x << 4) & 0x30c30c3;
+    x = (x | x << 2) & 0x9249249;
+    return x;
+}
+
+inline uint32_t ray_sort_key(const ray& r, const aabb& origins)
+{
+    // The direction's octant in the top 3 bits, then a 27-bit Morton code of the origin's
+    // cell in `origins`, the bounds of the batch's origins. One scale for all axes, as for
+    // the LBVH codes, so that flat batches spend their bits on their wide axes.
+    constexpr int axis_bits = 9;
+    constexpr double cells = 1 << axis_bits;
+    double size = std::fmax(origins.x.size(), std::fmax(origins.y.size(), origins.z.size()));
+    double scale = size > 0 ? cells / size : 0;
+
+    uint32_t key = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        double u = (r.origin()[axis] - origins.axis_interval(axis).min) * scale;
+        auto cell = uint32_t(std::fmin(std::fmax(u, 0.0), cells - 1));
+        key |= spread_bits_3d(cell) << (2 - axis);
+        key |= uint32_t(r.direction()[axis] < 0) << (3 * axis_bits + axis);
+    }
+    return key;
+}
+
+inline void sort_by_key(std::vector<uint32_t>& keys, std::vector<int>& values)
+{
+    // Least significant digit radix sort, 8 bits per pass. Batches are sorted inside one
+    // render thread, so unlike the LBVH builder's sort this one is serial. A pass in which all
+    // keys share the digit would move nothing and is skipped.
+    constexpr int radix_bits = 8;
+    constexpr size_t radix = size_t(1) << radix_bits;
+    const size_t n = keys.size();
+    std::vector<uint32_t> key_buffer(n);
+    std::vector<int> value_buffer(n);
+
+    for (int shift = 0; shift < 32; shift += radix_bits)
+    {
+        size_t offsets[radix] = {};
+        for (size_t i = 0; i < n; i++)
+            offsets[(keys[i] >> shift) & (radix - 1)]++;
+
+        size_t sum = 0;
+        bool one_digit = false;
+        for (size_t digit = 0; digit < radix; digit++)
+        {
+            size_t count = offsets[digit];
+            offsets[digit] = sum;
+            sum += count;
+            one_digit |= count == n;
+        }
+        if (one_digit)
+            continue;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t to = offsets[(keys[i] >> shift) & (radix - 1)]++;
+            key_buffer[to] = keys[i];
+            value_buffer[to] = values[i];
+        }
+        keys.swap(key_buffer);
+        values.swap(value_buffer);
+    }
+}
+
+#endif
\ No newline at end of file
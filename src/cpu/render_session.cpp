@@ -0,0 +1,107 @@
+#include "render_session.h"
+
+#include <execution>
+#include <vector>
+
+render_session::render_session(std::shared_ptr<const scene> s, const render_config& config)
+    : s(std::move(s)), cam(this->s->cam)
+{
+    configure_camera(cam, config);
+    cam.initialize();
+}
+
+int render_session::image_width() const
+{
+    return cam.image_width;
+}
+
+int render_session::image_height() const
+{
+    return cam.get_image_height();
+}
+
+int render_session::samples_per_pixel() const
+{
+    return cam.samples_per_pixel;
+}
+
+bool render_session::render(color* pixels)
+{
+    int width = cam.image_width;
+    auto tiles = split_into_tiles(width, cam.get_image_height(), tile_size);
+    auto pixel_samples_scale = 1.0 / cam.samples_per_pixel;
+    std::atomic<size_t> tiles_done(0);
+
+    std::for_each(std::execution::par, tiles.begin(), tiles.end(),
+                  [&](const tile& t)
+                  {
+                      if (!wait_while_paused())
+                          return;
+
+                      std::vector<color> sums(t.pixel_count());
+                      cam.render_tile(s->world, s->lights, t, 0, cam.samples_per_pixel,
+                                      sums.data());
+                      for (int j = t.y0; j < t.y1; j++)
+                      {
+                          for (int i = t.x0; i < t.x1; i++)
+                          {
+                              auto& sum = sums[(j - t.y0) * t.width() + (i - t.x0)];
+                              pixels[size_t(j) * width + i] = pixel_samples_scale * sum;
+                          }
+                      }
+
+                      auto done = ++tiles_done;
+                      if (on_tile)
+                      {
+                          std::lock_guard<std::mutex> lock(callback_mutex);
+                          on_tile(t, done, tiles.size());
+                      }
+                  });
+
+    // A cancel that arrives after the last tile has started skips nothing, so judge by the
+    // tiles rendered rather than by the flag.
+    return tiles_done == tiles.size();
+}
+
+void render_session::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        cancelled = true;
+    }
+    state_changed.notify_all();
+}
+
+void render_session::pause()
+{
+    std::lock_guard<std::mutex> lock(state_mutex);
+    paused = true;
+}
+
+void render_session::resume()
+{
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        paused = false;
+    }
+    state_changed.notify_all();
+}
+
+bool render_session::is_cancelled() const
+{
+    return cancelled;
+}
+
+bool render_session::is_paused() const
+{
+    return paused;
+}
+
+bool render_session::wait_while_paused()
+{
+    // Holds a rendering thread before its next tile while the session is paused. Returns
+    // false once the session is cancelled.
+    std::unique_lock<std::mutex> lock(state_mutex);
+    state_changed.wait(lock, [this] { return !paused || cancelled; });
+    return !cancelled;
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef RENDER_SESSION_H
+#define RENDER_SESSION_H
+
+// Library entry point of the CPU path tracer (the pathtracer_core target). A session renders
+// one view of a scene into a buffer owned by the caller and can be observed, paused and
+// cancelled from other threads, so the tracer can be embedded without scraping its output.
+
+#include "rtweekend.h"
+
+#include "scene.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+class render_session
+{
+  public:
+    // Called once per finished tile, after its pixels are in the buffer. Calls are serialized
+    // but come from the rendering threads.
+    using progress_callback =
+        std::function<void(const tile& t, size_t tiles_done, size_t tiles_total)>;
+
+    int tile_size = 32;           // Tile edge length; pause and cancel take effect between tiles
+    progress_callback on_tile;    // Optional progress observer
+
+    // Renders `s` with the overrides in `config`; the scene itself is only read, so several
+    // sessions may share it.
+    render_session(std::shared_ptr<const scene> s, const render_config& config);
+
+    int image_width() const;
+    int image_height() const;
+    int samples_per_pixel() const;
+
+    // Renders the image into `pixels`, image_width() * image_height() normalized colors in
+    // row-major order. Blocks until every tile is done or the session is cancelled. Returns
+    // whether every tile was rendered; tiles skipped by a cancel are left untouched.
+    bool render(color* pixels);
+
+    // Thread-safe controls. Tiles in flight run to completion. A cancelled session stays
+    // cancelled.
+    void cancel();
+    void pause();
+    void resume();
+    bool is_cancelled() const;
+    bool is_paused() const;
+
+  private:
+    std::shared_ptr<const scene> s;
+    camera cam;
+
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> paused{false};
+    std::mutex state_mutex;
+    std::condition_variable state_changed;
+    std::mutex callback_mutex;
+
+    bool wait_while_paused();
+};
+
+#endif
\ No newline at end of file
@@ -2,7 +2,9 @@
 #define RTWEEKEND_H
 
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <limits>
 #include <memory>
@@ -42,11 +44,40 @@ inline int random_int(int min, int max)
     return int(random_double(min, max + 1));
 }
 
+template <typename real = double> constexpr real gamma_bound(int n)
+{
+    // Bound on the relative error that n rounded operations can accumulate: (1 + u)^n - 1 is
+    // at most n u / (1 - n u), where u is the unit roundoff of `real` (Higham; as in pbrt).
+    constexpr real u = std::numeric_limits<real>::epsilon() / 2;
+    return (n * u) / (1 - n * u);
+}
+
+inline double next_double_up(double v)
+{
+    // The next representable double above v, found by stepping its bits, which unlike
+    // std::nextafter needs no library call (as in pbrt).
+    if (std::isinf(v) && v > 0)
+        return v;
+    if (v == 0)
+        v = 0; // Turns -0 into +0, whose successor is the smallest positive double
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(v));
+    bits = v >= 0 ? bits + 1 : bits - 1;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+inline double next_double_down(double v)
+{
+    return -next_double_up(-v);
+}
+
 // Common Headers
 
 #include "color.h"
 #include "interval.h"
 #include "ray.h"
+#include "sampling.h"
 #include "vec3.h"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,382 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "rtweekend.h"
+
+#include <cstdint>
+
+// Bit mixing and hashing helpers used to decorrelate sample sequences between pixels and
+// dimensions.
+
+inline uint64_t mix_bits(uint64_t v)
+{
+    v ^= (v >> 31);
+    v *= 0x7fb5d329728ea185ULL;
+    v ^= (v >> 27);
+    v *= 0x81dadef4bc2dd44dULL;
+    v ^= (v >> 33);
+    return v;
+}
+
+inline uint64_t hash_values(uint64_t a, uint64_t b, uint64_t c = 0, uint64_t d = 0)
+{
+    uint64_t h = mix_bits(a + 0x9e3779b97f4a7c15ULL);
+    h = mix_bits(h ^ (b + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)));
+    h = mix_bits(h ^ (c + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)));
+    h = mix_bits(h ^ (d + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)));
+    return h;
+}
+
+inline uint32_t reverse_bits(uint32_t v)
+{
+    v = (v << 16) | (v >> 16);
+    v = ((v & 0x00ff00ff) << 8) | ((v & 0xff00ff00) >> 8);
+    v = ((v & 0x0f0f0f0f) << 4) | ((v & 0xf0f0f0f0) >> 4);
+    v = ((v & 0x33333333) << 2) | ((v & 0xcccccccc) >> 2);
+    v = ((v & 0x55555555) << 1) | ((v & 0xaaaaaaaa) >> 1);
+    return v;
+}
+
+inline uint32_t permutation_element(uint32_t i, uint32_t l, uint32_t p)
+{
+    // Returns the i-th element of a random permutation of [0,l) selected by `p`, without
+    // storing the permutation (Kensler, "Correlated Multi-Jittered Sampling").
+    uint32_t w = l - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do
+    {
+        i ^= p;
+        i *= 0xe170893d;
+        i ^= p >> 16;
+        i ^= (i & w) >> 4;
+        i ^= p >> 8;
+        i *= 0x0929eb3f;
+        i ^= p >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1 | p >> 27;
+        i *= 0x6935fa69;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3df;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= l);
+    return (i + p) % l;
+}
+
+inline double u32_to_unit(uint32_t v)
+{
+    // Maps a 32-bit integer to [0,1).
+    return v * 0x1p-32;
+}
+
+class rng
+{
+  public:
+    // PCG32 (O'Neill), small and fast enough to give every pixel sample its own stream.
+
+    rng() : rng(0x853c49e6748fea9bULL, 0xda3e39cb94b95bdbULL) {}
+
+    rng(uint64_t seq_index, uint64_t offset) { set_sequence(seq_index, offset); }
+
+    void set_sequence(uint64_t seq_index, uint64_t offset)
+    {
+        state = 0u;
+        inc = (seq_index << 1u) | 1u;
+        next_uint();
+        state += offset;
+        next_uint();
+    }
+
+    uint32_t next_uint()
+    {
+        uint64_t oldstate = state;
+        state = oldstate * 0x5851f42d4c957f2dULL + inc;
+        uint32_t xorshifted = uint32_t(((oldstate >> 18u) ^ oldstate) >> 27u);
+        uint32_t rot = uint32_t(oldstate >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31));
+    }
+
+    double next_double() { return u32_to_unit(next_uint()); }
+
+  private:
+    uint64_t state, inc;
+};
+
+enum class sampler_type
+{
+    independent,
+    stratified,
+    halton,
+    sobol
+};
+
+class sampler
+{
+  public:
+    // A sampler hands out the uniform numbers for one pixel sample. Each call to get_1d/get_2d
+    // consumes the next dimension(s) of the sample vector, so as long as the camera and
+    // materials request numbers in the same order, dimension d of every sample in a pixel
+    // comes from the same well-distributed sequence.
+
+    virtual ~sampler() = default;
+
+    virtual void start_pixel_sample(int i, int j, int sample_index) = 0;
+
+    virtual double get_1d() = 0;
+
+    // Returns a point in [0,1)^2 in the x and y components.
+    virtual vec3 get_2d() = 0;
+};
+
+class independent_sampler : public sampler
+{
+  public:
+    independent_sampler(int seed = 0) : seed(seed) {}
+
+    void start_pixel_sample(int i, int j, int sample_index) override
+    {
+        gen = rng(hash_values(i, j, seed), mix_bits(uint64_t(sample_index) + 1));
+    }
+
+    double get_1d() override { return gen.next_double(); }
+
+    vec3 get_2d() override
+    {
+        auto u = gen.next_double();
+        return vec3(u, gen.next_double(), 0);
+    }
+
+  private:
+    int seed;
+    rng gen;
+};
+
+class stratified_sampler : public sampler
+{
+  public:
+    // Jittered stratification. Every dimension splits [0,1) (or [0,1)^2) into one stratum per
+    // pixel sample and visits the strata in a per-pixel, per-dimension random order.
+
+    stratified_sampler(int samples_per_pixel, int seed = 0)
+        : samples_per_pixel(samples_per_pixel), seed(seed)
+    {
+        strata_per_axis = int(std::ceil(std::sqrt(double(samples_per_pixel))));
+    }
+
+    void start_pixel_sample(int i, int j, int sample_index) override
+    {
+        pixel_hash = hash_values(i, j, seed);
+        this->sample_index = sample_index;
+        dimension = 0;
+        gen = rng(pixel_hash, mix_bits(uint64_t(sample_index) + 1));
+    }
+
+    double get_1d() override
+    {
+        uint32_t h = uint32_t(hash_values(pixel_hash, dimension++));
+        uint32_t stratum = permuted_index(samples_per_pixel, h);
+        return (stratum + gen.next_double()) / samples_per_pixel;
+    }
+
+    vec3 get_2d() override
+    {
+        uint32_t h = uint32_t(hash_values(pixel_hash, dimension));
+        dimension += 2;
+
+        int n = strata_per_axis;
+        uint32_t stratum = permuted_index(n * n, h);
+        auto dx = gen.next_double();
+        auto dy = gen.next_double();
+        return vec3((stratum % n + dx) / n, (stratum / n + dy) / n, 0);
+    }
+
+  private:
+    int samples_per_pixel;
+    int seed;
+    int strata_per_axis;
+    uint64_t pixel_hash = 0;
+    int sample_index = 0;
+    int dimension = 0;
+    rng gen;
+
+    uint32_t permuted_index(uint32_t count, uint32_t h) const
+    {
+        // Sample indices past the stratum count (e.g. extra passes) wrap onto a fresh
+        // permutation rather than reusing strata in the same order.
+        uint32_t round = uint32_t(sample_index) / count;
+        return permutation_element(uint32_t(sample_index) % count, count,
+                                   uint32_t(mix_bits(h ^ round)));
+    }
+};
+
+class halton_sampler : public sampler
+{
+  public:
+    // Halton sequence with Owen-scrambled digits. Dimension d uses the d-th prime as its base
+    // and a scramble seeded by the pixel, so neighbouring pixels see decorrelated point sets.
+    // Dimensions beyond the prime table fall back to independent random numbers.
+
+    halton_sampler(int seed = 0) : seed(seed) {}
+
+    void start_pixel_sample(int i, int j, int sample_index) override
+    {
+        pixel_hash = hash_values(i, j, seed);
+        this->sample_index = uint64_t(sample_index);
+        dimension = 0;
+        gen = rng(pixel_hash, mix_bits(uint64_t(sample_index) + 1));
+    }
+
+    double get_1d() override { return sample_dimension(dimension++); }
+
+    vec3 get_2d() override
+    {
+        auto u = sample_dimension(dimension++);
+        return vec3(u, sample_dimension(dimension++), 0);
+    }
+
+  private:
+    static constexpr int prime_count = 64;
+    static constexpr int primes[prime_count] = {
+        2,   3,   5,   7,   11,  13,  17,  19,  23,  29,  31,  37,  41,  43,  47,  53,
+        59,  61,  67,  71,  73,  79,  83,  89,  97,  101, 103, 107, 109, 113, 127, 131,
+        137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+        227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311};
+
+    int seed;
+    uint64_t pixel_hash = 0;
+    uint64_t sample_index = 0;
+    int dimension = 0;
+    rng gen;
+
+    double sample_dimension(int dim)
+    {
+        if (dim >= prime_count)
+            return gen.next_double();
+        return owen_scrambled_radical_inverse(primes[dim], sample_index,
+                                              uint32_t(hash_values(pixel_hash, dim)));
+    }
+
+    static double owen_scrambled_radical_inverse(int base, uint64_t a, uint32_t hash)
+    {
+        // Each digit is permuted by a hash of the digits that precede it, which is the nested
+        // uniform scramble. The loop continues past the last nonzero digit so the trailing
+        // zeros get scrambled too.
+        const double inv_base = 1.0 / base;
+        double inv_base_m = 1;
+        uint64_t reversed_digits = 0;
+
+        while (1 - (base - 1) * inv_base_m < 1)
+        {
+            uint64_t next = a / base;
+            int digit_value = int(a - next * base);
+            uint32_t digit_hash = uint32_t(mix_bits(hash ^ reversed_digits));
+            digit_value = int(permutation_element(uint32_t(digit_value), base, digit_hash));
+            reversed_digits = reversed_digits * base + digit_value;
+            inv_base_m *= inv_base;
+            a = next;
+        }
+
+        return std::fmin(inv_base_m * reversed_digits, 1 - 0x1p-53);
+    }
+};
+
+class sobol_sampler : public sampler
+{
+  public:
+    // Owen-scrambled Sobol, padded per dimension pair. Each 2D request draws from the first two
+    // Sobol dimensions (a (0,2)-sequence) with its own sample-index shuffle and scramble, which
+    // keeps every 2D projection well stratified at any sample count.
+
+    sobol_sampler(int seed = 0) : seed(seed) {}
+
+    void start_pixel_sample(int i, int j, int sample_index) override
+    {
+        pixel_hash = hash_values(i, j, seed);
+        this->sample_index = uint32_t(sample_index);
+        dimension = 0;
+    }
+
+    double get_1d() override
+    {
+        uint64_t h = hash_values(pixel_hash, dimension++);
+        uint32_t index = shuffled_index(uint32_t(h));
+        return u32_to_unit(owen_scramble(reverse_bits(index), uint32_t(h >> 32)));
+    }
+
+    vec3 get_2d() override
+    {
+        uint64_t h = hash_values(pixel_hash, dimension);
+        dimension += 2;
+
+        uint32_t index = shuffled_index(uint32_t(h));
+        uint32_t scramble = uint32_t(h >> 32);
+        auto u = u32_to_unit(owen_scramble(reverse_bits(index), scramble));
+        auto v = u32_to_unit(owen_scramble(sobol_second_dimension(index), mix_bits(scramble)));
+        return vec3(u, v, 0);
+    }
+
+  private:
+    int seed;
+    uint64_t pixel_hash = 0;
+    uint32_t sample_index = 0;
+    int dimension = 0;
+
+    uint32_t shuffled_index(uint32_t h) const
+    {
+        // Nested uniform shuffle (Burley 2020): Owen-scrambling the index keeps every
+        // power-of-two prefix of the shuffled sequence a stratified net, so images stay well
+        // sampled when rendering stops at any sample count, not only at samples_per_pixel.
+        return owen_scramble(sample_index, h);
+    }
+
+    static uint32_t sobol_second_dimension(uint32_t index)
+    {
+        // The second Sobol dimension's generator matrix is the upper-triangular Pascal matrix
+        // mod 2; its columns are produced by v ^= v >> 1.
+        uint32_t x = 0;
+        for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+        {
+            if (index & 1)
+                x ^= v;
+        }
+        return x;
+    }
+
+    static uint32_t owen_scramble(uint32_t v, uint32_t seed)
+    {
+        // Hash-based nested uniform scramble (Laine-Karras, with Vegdahl's constants).
+        v = reverse_bits(v);
+        v ^= v * 0x3d20adea;
+        v += seed;
+        v *= (seed >> 16) | 1;
+        v ^= v * 0x05526c56;
+        v ^= v * 0x53a22864;
+        return reverse_bits(v);
+    }
+};
+
+inline std::unique_ptr<sampler> make_sampler(sampler_type type, int samples_per_pixel, int seed)
+{
+    switch (type)
+    {
+    case sampler_type::stratified:
+        return std::make_unique<stratified_sampler>(samples_per_pixel, seed);
+    case sampler_type::halton:
+        return std::make_unique<halton_sampler>(seed);
+    case sampler_type::sobol:
+        return std::make_unique<sobol_sampler>(seed);
+    case sampler_type::independent:
+    default:
+        return std::make_unique<independent_sampler>(seed);
+    }
+}
+
+#endif
\ No newline at end of file
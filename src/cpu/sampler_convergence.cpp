@@ -0,0 +1,133 @@
+#include "rtweekend.h"
+
+#include "scene.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Measures how quickly each sampler converges on a scene: renders it at increasing sample
+// counts and prints the RMSE of each image against a high sample count reference. Errors are
+// in 8-bit output values, after the gamma transform of write_color, so they match what a
+// viewer of the image sees. Every figure is printed as one `key: value` line, as bvh_stats
+// does, so that sampler changes can be compared run to run.
+
+struct named_sampler
+{
+    std::string name;
+    sampler_type type;
+};
+
+std::vector<double> render_bytes(camera cam, const scene& s, sampler_type type, int spp,
+                                 int seed)
+{
+    // Renders the scene's view with `type` at `spp` samples per pixel, returning the output
+    // byte of every channel of every pixel as write_color would write it.
+    cam.sampler_kind = type;
+    cam.samples_per_pixel = spp;
+    cam.seed = seed;
+    cam.initialize();
+
+    int image_width = cam.image_width;
+    int image_height = cam.get_image_height();
+    std::vector<color> sums(size_t(image_width) * image_height);
+    render_tile_parallel(cam, s.world, s.lights, tile(0, 0, image_width, image_height), 0, spp,
+                         sums.data());
+
+    static const interval intensity(0.000, 0.999);
+    std::vector<double> bytes;
+    bytes.reserve(sums.size() * 3);
+    for (const auto& sum : sums)
+    {
+        for (int channel = 0; channel < 3; channel++)
+            bytes.push_back(int(256 * intensity.clamp(linear_to_gamma(sum[channel] / spp))));
+    }
+    return bytes;
+}
+
+double rmse(const std::vector<double>& a, const std::vector<double>& b)
+{
+    double sum = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        sum += (a[i] - b[i]) * (a[i] - b[i]);
+    return std::sqrt(sum / a.size());
+}
+
+int main(int argc, char* argv[])
+{
+    render_config config;
+    config.image_width = 80;
+    std::string sampler_name = "all";
+    int max_spp = 64, reference_spp = 1024;
+
+    for (int i = 1; i < argc; i++)
+    {
+        auto arg = std::string(argv[i]);
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--scene" && has_value)
+            config.scene_id = std::atoi(argv[++i]);
+        else if (arg == "--width" && has_value)
+            config.image_width = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--sampler" && has_value)
+            sampler_name = argv[++i];
+        else if (arg == "--max-spp" && has_value)
+            max_spp = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--reference-spp" && has_value)
+            reference_spp = std::max(1, std::atoi(argv[++i]));
+        else
+        {
+            std::cerr
+                << "Usage: sampler_convergence [options]\n"
+                   "  --scene <n>           Scene to render, as for cpu_pt (default 1)\n"
+                   "  --width <px>          Image width (default 80)\n"
+                   "  --sampler <name>      independent, stratified, halton, sobol or all\n"
+                   "                        (default)\n"
+                   "  --max-spp <n>         Highest sample count measured; counts double from\n"
+                   "                        1 up to it (default 64)\n"
+                   "  --reference-spp <n>   Samples per pixel of the reference (default 1024)\n";
+            return 1;
+        }
+    }
+
+    std::vector<named_sampler> samplers = {
+        {"independent", sampler_type::independent},
+        {"stratified", sampler_type::stratified},
+        {"halton", sampler_type::halton},
+        {"sobol", sampler_type::sobol},
+    };
+
+    auto selected = [&](const named_sampler& named)
+    { return sampler_name == "all" || sampler_name == named.name; };
+    if (std::none_of(samplers.begin(), samplers.end(), selected))
+    {
+        std::cerr << "sampler_convergence: unknown sampler " << sampler_name << '\n';
+        return 1;
+    }
+
+    scene s = make_scene(config);
+
+    // The reference uses independent samples under a seed no measured render uses, so that
+    // it shares no error with any of them, the independent sampler's own included.
+    auto reference = render_bytes(s.cam, s, sampler_type::independent, reference_spp, 7919);
+
+    std::printf("scene: %d\n", config.scene_id);
+    std::printf("image_width: %d\n", config.image_width);
+    std::printf("reference_spp: %d\n\n", reference_spp);
+
+    for (const auto& named : samplers)
+    {
+        if (!selected(named))
+            continue;
+
+        std::printf("sampler: %s\n", named.name.c_str());
+        for (int spp = 1; spp <= max_spp; spp *= 2)
+        {
+            auto image = render_bytes(s.cam, s, named.type, spp, 0);
+            std::printf("rmse_spp_%d: %.3f\n", spp, rmse(image, reference));
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "vec3.h"
+
+// Analytic warps from the unit square [0,1)^2 to common sampling domains. Each warp consumes
+// exactly two uniform numbers, so callers can feed them from stratified or low-discrepancy
+// sequences and every sample costs the same amount of work.
+
+inline vec3 sample_uniform_disk_concentric(double u1, double u2)
+{
+    // Shirley-Chiu concentric mapping: preserves stratification and relative areas.
+    double ox = 2 * u1 - 1;
+    double oy = 2 * u2 - 1;
+
+    if (ox == 0 && oy == 0)
+        return vec3(0, 0, 0);
+
+    double r, theta;
+    if (std::fabs(ox) > std::fabs(oy))
+    {
+        r = ox;
+        theta = (pi / 4) * (oy / ox);
+    }
+    else
+    {
+        r = oy;
+        theta = (pi / 2) - (pi / 4) * (ox / oy);
+    }
+
+    return vec3(r * std::cos(theta), r * std::sin(theta), 0);
+}
+
+inline vec3 sample_uniform_sphere(double u1, double u2)
+{
+    auto z = 1 - 2 * u1;
+    auto r = std::sqrt(std::fmax(0.0, 1 - z * z));
+    auto phi = 2 * pi * u2;
+    return vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+inline vec3 sample_cosine_hemisphere(double u1, double u2)
+{
+    // Malley's method: project a uniform disk sample up onto the +z hemisphere.
+    auto d = sample_uniform_disk_concentric(u1, u2);
+    auto z = std::sqrt(std::fmax(0.0, 1 - d.x() * d.x() - d.y() * d.y()));
+    return vec3(d.x(), d.y(), z);
+}
+
+inline vec3 sample_uniform_cone(double u1, double u2, double cos_theta_max)
+{
+    // Uniform direction inside the cone of half-angle acos(cos_theta_max) around +z.
+    auto z = 1 - u1 * (1 - cos_theta_max);
+    auto r = std::sqrt(std::fmax(0.0, 1 - z * z));
+    auto phi = 2 * pi * u2;
+    return vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+inline double cosine_hemisphere_pdf(double cos_theta)
+{
+    return cos_theta / pi;
+}
+
+inline double uniform_sphere_pdf()
+{
+    return 1 / (4 * pi);
+}
+
+inline double uniform_cone_pdf(double cos_theta_max)
+{
+    return 1 / (2 * pi * (1 - cos_theta_max));
+}
+
+inline double power_heuristic(double f_pdf, double g_pdf)
+{
+    // Veach's power heuristic (beta = 2) for combining two sampling strategies.
+    auto f = f_pdf * f_pdf;
+    auto g = g_pdf * g_pdf;
+    return (f + g > 0) ? f / (f + g) : 0;
+}
+
+inline vec3 random_unit_vector()
+{
+    return sample_uniform_sphere(random_double(), random_double());
+}
+
+inline vec3 random_in_unit_disk()
+{
+    return sample_uniform_disk_concentric(random_double(), random_double());
+}
+
+inline vec3 random_cosine_direction()
+{
+    return sample_cosine_hemisphere(random_double(), random_double());
+}
+
+inline vec3 random_on_hemisphere(const vec3& normal)
+{
+    vec3 on_unit_sphere = random_unit_vector();
+    if (dot(on_unit_sphere, normal) > 0.0) // In the same hemisphere as the normal
+        return on_unit_sphere;
+    else
+        return -on_unit_sphere;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,606 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "arena.h"
+#include "bvh.h"
+#include "camera.h"
+#include "compact_bvh.h"
+#include "hittable_list.h"
+#include "light.h"
+#include "material.h"
+#include "plane.h"
+#include "quad.h"
+#include "sphere.h"
+
+#include <cstdint>
+#include <execution>
+#include <numeric>
+#include <vector>
+
+class scene
+{
+  public:
+    // Primitives, materials and BVH nodes live in `memory`, which is declared first so that
+    // it is released last, in one go.
+    std::unique_ptr<arena> memory = std::make_unique<arena>();
+    hittable_list world;
+    light_list lights;
+    camera cam; // Default view and render settings for the scene
+
+    scene() = default;
+    scene(scene&&) = default;
+
+    scene& operator=(scene&& other)
+    {
+        // Member-wise assignment would replace the arena first and then release `world` and
+        // `lights`, whose objects it held. Drop them before the arena instead.
+        if (this != &other)
+        {
+            world = hittable_list();
+            lights = light_list();
+            memory = std::move(other.memory);
+            world = std::move(other.world);
+            lights = std::move(other.lights);
+            cam = std::move(other.cam);
+        }
+        return *this;
+    }
+};
+
+enum class accel_type
+{
+    bvh,     // bvh_node: binary tree of heap or arena nodes linked by shared_ptr
+    compact, // compact_bvh: flat 4-wide tree with quantized child boxes
+    sbvh,    // compact_bvh built with spatial splits, for scenes with large primitives
+    lbvh,    // compact_bvh built from Morton codes in linear time, for fast rebuilds
+    lbvh_sah, // lbvh with its treelets restructured for surface area
+    none      // No acceleration structure, for tools that build their own
+};
+
+inline shared_ptr<hittable> build_bvh(const hittable_list& list, arena& mem, accel_type accel)
+{
+    if (accel == accel_type::bvh)
+        return mem.make<bvh_node>(list, &mem);
+    if (accel == accel_type::compact)
+        return mem.make<compact_bvh>(list);
+
+    const auto& objects = list.objects;
+    std::vector<aabb> boxes;
+    boxes.reserve(objects.size());
+    for (const auto& object : objects)
+        boxes.push_back(object->bounding_box());
+
+    if (accel == accel_type::sbvh)
+    {
+        auto clip = [&](int index, const aabb& region)
+        { return objects[index]->clipped_box(region); };
+        return mem.make<compact_bvh>(objects, bvh_build::spatial_split(boxes, clip));
+    }
+    return mem.make<compact_bvh>(objects,
+                                 bvh_build::morton(boxes, 63, accel == accel_type::lbvh_sah));
+}
+
+inline void split_large_primitives(const hittable_list& list, hittable_list& bounded,
+                                   hittable_list& large, double large_fraction = 0.25)
+{
+    // Separates out the primitives too large to sit well in a BVH. These are all unbounded
+    // ones, such as planes, and up to max_large, largest first, whose box has more than
+    // `large_fraction` of the surface area of the box around the bounded primitives, like a
+    // ground sphere; they would overlap every node.
+    const size_t max_large = 8;
+
+    std::vector<double> areas(list.objects.size());
+    std::vector<size_t> unbounded;
+    aabb scene_box = aabb::empty;
+    for (size_t i = 0; i < list.objects.size(); i++)
+    {
+        aabb box = list.objects[i]->bounding_box();
+        areas[i] = bvh_build::surface_area(box);
+        if (std::isfinite(areas[i]))
+            scene_box = aabb(scene_box, box);
+        else
+            unbounded.push_back(i);
+    }
+
+    std::vector<size_t> candidates;
+    double threshold = large_fraction * bvh_build::surface_area(scene_box);
+    for (size_t i = 0; i < list.objects.size(); i++)
+    {
+        if (std::isfinite(areas[i]) && areas[i] > threshold)
+            candidates.push_back(i);
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [&](size_t a, size_t b) { return areas[a] > areas[b]; });
+    if (candidates.size() > max_large)
+        candidates.resize(max_large);
+    candidates.insert(candidates.begin(), unbounded.begin(), unbounded.end());
+
+    std::vector<bool> is_large(list.objects.size(), false);
+    for (size_t i : candidates)
+    {
+        is_large[i] = true;
+        large.add(list.objects[i]);
+    }
+    for (size_t i = 0; i < list.objects.size(); i++)
+    {
+        if (!is_large[i])
+            bounded.add(list.objects[i]);
+    }
+}
+
+inline hittable_list build_accelerator(const hittable_list& list, arena& mem, accel_type accel,
+                                       double large_fraction = 0.25)
+{
+    // Returns the world to trace: a BVH over the scene's primitives, followed by the large
+    // ones, which each ray tests directly.
+    if (accel == accel_type::none)
+        return list;
+
+    hittable_list bounded, large, world;
+    split_large_primitives(list, bounded, large, large_fraction);
+    if (!bounded.objects.empty())
+        world.add(build_bvh(bounded, mem, accel));
+    for (const auto& object : large.objects)
+        world.add(object);
+    return world;
+}
+
+enum class node_layout
+{
+    depth_first, // compact_bvh nodes in the order the tree was built
+    treelet,     // Page-sized treelets grown by surface area
+    frequency    // Page-sized treelets grown by visit counts from a small profile render
+};
+
+inline void apply_node_layout(scene& s, node_layout layout)
+{
+    // Reorders the nodes of a compact_bvh in the world; other accelerators keep their layout. The
+    // profile render traces a few samples of the scene's own view from one thread, counting
+    // shadow rays as well; surface areas only break ties between nodes it never reached.
+    shared_ptr<compact_bvh> bvh;
+    for (const auto& object : s.world.objects)
+    {
+        if (!bvh)
+            bvh = std::dynamic_pointer_cast<compact_bvh>(object);
+    }
+    if (!bvh || layout == node_layout::depth_first)
+        return;
+
+    auto weights = bvh->area_weights();
+    if (layout == node_layout::frequency)
+    {
+        camera cam = s.cam;
+        cam.image_width = std::min(cam.image_width, 96);
+        cam.initialize();
+        int samples = std::min(cam.samples_per_pixel, 4);
+
+        // The world as it is, with the counter standing in for the BVH.
+        auto counter = make_shared<visit_counter>(*bvh);
+        hittable_list profiled;
+        for (const auto& object : s.world.objects)
+            profiled.add(object == bvh ? counter : object);
+
+        std::vector<color> sums(size_t(cam.image_width) * cam.get_image_height());
+        cam.render_tile(profiled, s.lights, tile(0, 0, cam.image_width, cam.get_image_height()),
+                        0, samples, sums.data());
+
+        double root_area = weights[0] > 0 ? weights[0] : 1;
+        for (size_t i = 0; i < weights.size(); i++)
+            weights[i] = counter->visits[i] + weights[i] / root_area;
+    }
+    bvh->reorder(weights);
+}
+
+inline scene bouncing_spheres(accel_type accel = accel_type::bvh, bool moving = false)
+{
+    // With `moving`, the diffuse spheres bounce up during the frame and the shutter stays
+    // open for all of it, blurring them.
+    scene s;
+    auto& mem = *s.memory;
+    auto& world = s.world;
+
+    // Construct world
+    auto ground_material = mem.make<lambertian>(color(0.5, 0.5, 0.5));
+    world.add(mem.make<sphere>(point3(0, -1000, 0), 1000, ground_material));
+
+    for (int a = -11; a < 11; a++)
+    {
+        for (int b = -11; b < 11; b++)
+        {
+            auto choose_mat = random_double();
+            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9)
+            {
+                shared_ptr<material> sphere_material;
+
+                if (choose_mat < 0.8)
+                {
+                    // diffuse
+                    auto albedo = color::random() * color::random();
+                    sphere_material = mem.make<lambertian>(albedo);
+                    if (moving)
+                    {
+                        auto center2 = center + vec3(0, random_double(0, .5), 0);
+                        world.add(mem.make<sphere>(center, center2, 0.2, sphere_material));
+                    }
+                    else
+                        world.add(mem.make<sphere>(center, 0.2, sphere_material));
+                }
+                else if (choose_mat < 0.95)
+                {
+                    // metal
+                    auto albedo = color::random(0.5, 1);
+                    auto fuzz = random_double(0, 0.5);
+                    sphere_material = mem.make<metal>(albedo, fuzz);
+                    world.add(mem.make<sphere>(center, 0.2, sphere_material));
+                }
+                else
+                {
+                    // glass
+                    sphere_material = mem.make<dielectric>(1.5);
+                    world.add(mem.make<sphere>(center, 0.2, sphere_material));
+                }
+            }
+        }
+    }
+
+    auto material1 = mem.make<dielectric>(1.5);
+    world.add(mem.make<sphere>(point3(0, 1, 0), 1.0, material1));
+
+    auto material2 = mem.make<lambertian>(color(0.4, 0.2, 0.1));
+    world.add(mem.make<sphere>(point3(-4, 1, 0), 1.0, material2));
+
+    auto material3 = mem.make<metal>(color(0.7, 0.6, 0.5), 0.0);
+    world.add(mem.make<sphere>(point3(4, 1, 0), 1.0, material3));
+
+    world = build_accelerator(world, mem, accel);
+
+    // Set up camera
+    auto& cam = s.cam;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 1200;
+    cam.samples_per_pixel = 500;
+    cam.max_depth = 50;
+
+    cam.vfov = 20;
+    cam.lookfrom = point3(13, 2, 3);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+
+    cam.defocus_angle = 0.6;
+    cam.focus_dist = 10.0;
+
+    if (moving)
+        cam.shutter_close = 1;
+
+    cam.sampler_kind = sampler_type::sobol;
+
+    return s;
+}
+
+inline scene glowing_spheres(accel_type accel = accel_type::bvh,
+                             light_sampler_type light_sampler = light_sampler_type::bvh)
+{
+    // The final scene at night: a share of the small spheres are emitters and the sky is off,
+    // so almost all light arrives through next-event estimation.
+    scene s;
+    auto& mem = *s.memory;
+    auto& world = s.world;
+    auto& lights = s.lights;
+
+    auto ground_material = mem.make<lambertian>(color(0.5, 0.5, 0.5));
+    world.add(mem.make<sphere>(point3(0, -1000, 0), 1000, ground_material));
+
+    for (int a = -11; a < 11; a++)
+    {
+        for (int b = -11; b < 11; b++)
+        {
+            auto choose_mat = random_double();
+            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9)
+            {
+                if (choose_mat < 0.25)
+                {
+                    // light
+                    auto emit = 4 * color::random(0.2, 1);
+                    auto light = mem.make<sphere>(center, 0.2, mem.make<diffuse_light>(emit));
+                    world.add(light);
+                    lights.add(light);
+                }
+                else if (choose_mat < 0.8)
+                {
+                    // diffuse
+                    auto albedo = color::random() * color::random();
+                    world.add(mem.make<sphere>(center, 0.2, mem.make<lambertian>(albedo)));
+                }
+                else if (choose_mat < 0.95)
+                {
+                    // metal
+                    auto albedo = color::random(0.5, 1);
+                    auto fuzz = random_double(0, 0.5);
+                    world.add(mem.make<sphere>(center, 0.2, mem.make<metal>(albedo, fuzz)));
+                }
+                else
+                {
+                    // glass
+                    world.add(mem.make<sphere>(center, 0.2, mem.make<dielectric>(1.5)));
+                }
+            }
+        }
+    }
+
+    world.add(mem.make<sphere>(point3(0, 1, 0), 1.0, mem.make<dielectric>(1.5)));
+    world.add(mem.make<sphere>(point3(-4, 1, 0), 1.0,
+                                  mem.make<lambertian>(color(0.4, 0.2, 0.1))));
+    world.add(mem.make<sphere>(point3(4, 1, 0), 1.0,
+                                  mem.make<metal>(color(0.7, 0.6, 0.5), 0.0)));
+
+    world = build_accelerator(world, mem, accel);
+    lights.build(light_sampler);
+
+    auto& cam = s.cam;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 1200;
+    cam.samples_per_pixel = 100;
+    cam.max_depth = 50;
+
+    cam.vfov = 20;
+    cam.lookfrom = point3(13, 2, 3);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+
+    cam.defocus_angle = 0.6;
+    cam.focus_dist = 10.0;
+
+    cam.sampler_kind = sampler_type::sobol;
+    cam.sky_background = false;
+
+    return s;
+}
+
+inline scene sphere_field(int count, accel_type accel = accel_type::bvh, bool glowing = false,
+                          light_sampler_type light_sampler = light_sampler_type::bvh)
+{
+    // `count` small spheres jittered over a square grid on the ground, for measuring scene
+    // construction and traversal at scale. Materials come from a small shared palette, so
+    // nearly all of the memory is primitives and BVH nodes. With `glowing`, one sphere in
+    // eight is an emitter of its own color and brightness and the sky is off, for measuring
+    // light selection among thousands of lights.
+    scene s;
+    auto& mem = *s.memory;
+    auto& world = s.world;
+    auto& lights = s.lights;
+
+    std::vector<shared_ptr<material>> palette;
+    for (int i = 0; i < 24; i++)
+        palette.push_back(mem.make<lambertian>(color::random() * color::random()));
+    for (int i = 0; i < 6; i++)
+        palette.push_back(mem.make<metal>(color::random(0.5, 1), random_double(0, 0.5)));
+    palette.push_back(mem.make<dielectric>(1.5));
+
+    int per_row = std::max(1, int(std::ceil(std::sqrt(double(count)))));
+    double spacing = 0.5;
+    double extent = per_row * spacing / 2;
+
+    world.add(mem.make<plane>(point3(0, 0, 0), vec3(0, 1, 0), palette[0]));
+    for (int i = 0; i < count; i++)
+    {
+        auto x = (i % per_row) * spacing - extent + 0.3 * random_double();
+        auto z = (i / per_row) * spacing - extent + 0.3 * random_double();
+        auto radius = random_double(0.05, 0.2);
+        if (glowing && random_double() < 0.125)
+        {
+            auto emit = 4 * color::random(0.2, 1);
+            auto light = mem.make<sphere>(point3(x, radius, z), radius,
+                                          mem.make<diffuse_light>(emit));
+            world.add(light);
+            lights.add(light);
+            continue;
+        }
+        auto mat = palette[std::min(size_t(random_double() * palette.size()), palette.size() - 1)];
+        world.add(mem.make<sphere>(point3(x, radius, z), radius, mat));
+    }
+
+    world = build_accelerator(world, mem, accel);
+    if (glowing)
+        lights.build(light_sampler);
+
+    auto& cam = s.cam;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 1200;
+    cam.samples_per_pixel = 32;
+    cam.max_depth = 50;
+
+    cam.vfov = 40;
+    cam.lookfrom = point3(0, 0.4 * extent + 2, extent + 4);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+
+    cam.defocus_angle = 0;
+    cam.focus_dist = (cam.lookfrom - cam.lookat).length();
+
+    cam.sampler_kind = sampler_type::sobol;
+    cam.sky_background = !glowing;
+
+    return s;
+}
+
+inline scene thin_quads(int count, accel_type accel = accel_type::bvh)
+{
+    // `count` long thin quads strewn over the ground in every direction, like fallen straws.
+    // Each is up to 8 long but only 0.02 wide, and those lying across the axes fill barely any
+    // of their bounding boxes, which overlap widely: the case that spatial splits are for.
+    scene s;
+    auto& mem = *s.memory;
+    auto& world = s.world;
+
+    std::vector<shared_ptr<material>> palette;
+    for (int i = 0; i < 24; i++)
+        palette.push_back(mem.make<lambertian>(color::random() * color::random()));
+    for (int i = 0; i < 6; i++)
+        palette.push_back(mem.make<metal>(color::random(0.5, 1), random_double(0, 0.5)));
+
+    double extent = 2 * std::sqrt(double(count)) * 0.1 + 4;
+
+    world.add(mem.make<plane>(point3(0, 0, 0), vec3(0, 1, 0), palette[0]));
+    for (int i = 0; i < count; i++)
+    {
+        auto heading = random_double(0, 2 * pi);
+        auto length = random_double(4, 8);
+        auto u = length * vec3(std::cos(heading), random_double(-0.05, 0.05), std::sin(heading));
+        auto v = 0.02 * unit_vector(cross(u, vec3(0, 1, 0)));
+        auto corner = point3(random_double(-extent, extent), random_double(0.05, 0.5),
+                             random_double(-extent, extent)) - 0.5 * u;
+        auto mat = palette[std::min(size_t(random_double() * palette.size()), palette.size() - 1)];
+        world.add(mem.make<quad>(corner, u, v, mat));
+    }
+
+    world = build_accelerator(world, mem, accel);
+
+    auto& cam = s.cam;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 1200;
+    cam.samples_per_pixel = 32;
+    cam.max_depth = 50;
+
+    cam.vfov = 40;
+    cam.lookfrom = point3(0, 0.6 * extent + 2, extent + 4);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+
+    cam.defocus_angle = 0;
+    cam.focus_dist = (cam.lookfrom - cam.lookat).length();
+
+    cam.sampler_kind = sampler_type::sobol;
+
+    return s;
+}
+
+struct render_config
+{
+    // Which scene to build and the render settings to override. Zero keeps the scene's own
+    // setting. Plain data, so it can be sent to other processes as is.
+    int32_t scene_id = 1;
+    int32_t primitive_count = 0; // Spheres or quads in scenes 3, 5 and 6
+    int32_t accel = 0;           // accel_type of the world's acceleration structure
+    int32_t node_layout = 0;     // node_layout of a compact_bvh world
+    int32_t light_sampler = 0;   // light_sampler_type of a scene with lights
+    int32_t image_width = 0;
+    int32_t samples_per_pixel = 0;
+    int32_t seed = 0;
+    int32_t ray_batch = 0; // camera::ray_batch
+    double aspect_ratio = 0;
+
+    // View override, applied when `has_view` is set. The field of view applies on its own.
+    int32_t has_view = 0;
+    double lookfrom[3] = {0, 0, 0};
+    double lookat[3] = {0, 0, 0};
+    double vfov = 0;
+
+    // Shutter interval override, applied when `has_shutter` is set.
+    int32_t has_shutter = 0;
+    double shutter[2] = {0, 0};
+};
+
+inline scene build_scene(int scene_id, int primitive_count = 0,
+                         accel_type accel = accel_type::bvh,
+                         node_layout layout = node_layout::depth_first,
+                         light_sampler_type light_sampler = light_sampler_type::bvh)
+{
+    // The scene builders draw from std::rand, so reseed first: every process (and every
+    // rebuild within a process) then constructs exactly the same world for a given id.
+    std::srand(1);
+
+    scene s;
+    switch (scene_id)
+    {
+    case 3:
+        s = sphere_field(primitive_count > 0 ? primitive_count : 1000000, accel);
+        break;
+    case 4:
+        s = bouncing_spheres(accel, true);
+        break;
+    case 5:
+        s = sphere_field(primitive_count > 0 ? primitive_count : 1000000, accel, true,
+                         light_sampler);
+        break;
+    case 6:
+        s = thin_quads(primitive_count > 0 ? primitive_count : 100000, accel);
+        break;
+    case 2:
+        s = glowing_spheres(accel, light_sampler);
+        break;
+    case 1:
+    default:
+        s = bouncing_spheres(accel);
+        break;
+    }
+
+    apply_node_layout(s, layout);
+    return s;
+}
+
+inline scene build_scene(const render_config& config)
+{
+    return build_scene(config.scene_id, config.primitive_count, accel_type(config.accel),
+                       node_layout(config.node_layout), light_sampler_type(config.light_sampler));
+}
+
+inline void configure_camera(camera& cam, const render_config& config)
+{
+    if (config.image_width > 0)
+        cam.image_width = config.image_width;
+    if (config.samples_per_pixel > 0)
+        cam.samples_per_pixel = config.samples_per_pixel;
+    if (config.aspect_ratio > 0)
+        cam.aspect_ratio = config.aspect_ratio;
+    cam.seed = config.seed;
+    cam.ray_batch = config.ray_batch;
+
+    if (config.has_view)
+    {
+        cam.lookfrom = point3(config.lookfrom[0], config.lookfrom[1], config.lookfrom[2]);
+        cam.lookat = point3(config.lookat[0], config.lookat[1], config.lookat[2]);
+        cam.focus_dist = (cam.lookfrom - cam.lookat).length();
+    }
+    if (config.vfov > 0)
+        cam.vfov = config.vfov;
+
+    if (config.has_shutter)
+    {
+        // Moving primitives are only bounded over the frame interval [0, 1], so times outside
+        // it would escape the BVH's boxes. Configs also arrive from other processes, so clamp.
+        cam.shutter_open = std::fmax(0.0, std::fmin(config.shutter[0], 1.0));
+        cam.shutter_close = std::fmax(cam.shutter_open, std::fmin(config.shutter[1], 1.0));
+    }
+}
+
+inline scene make_scene(const render_config& config)
+{
+    scene s = build_scene(config);
+    configure_camera(s.cam, config);
+    return s;
+}
+
+inline void render_tile_parallel(const camera& cam, const hittable& world,
+                                 const light_list& lights, const tile& t, int sample_begin,
+                                 int sample_end, color* sums)
+{
+    // Renders the tile's rows in parallel into `sums`.
+    std::vector<int> rows(t.height());
+    std::iota(rows.begin(), rows.end(), t.y0);
+    std::for_each(std::execution::par, rows.begin(), rows.end(),
+                  [&](int j)
+                  {
+                      cam.render_tile(world, lights, tile(t.x0, j, t.x1, j + 1), sample_begin,
+                                      sample_end, sums + (j - t.y0) * t.width());
+                  });
+}
+
+#endif
\ No newline at end of file
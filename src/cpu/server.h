@@ -0,0 +1,242 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+// Persistent render server. Scenes and their BVHs are built once and kept in memory, keyed
+// by the settings that define them, so a job only pays for tracing. Jobs arrive over a socket
+// as a render_job; the server renders them in passes and streams the image after every
+// pass, so clients can show progressive results.
+
+#include "net.h"
+#include "sampler.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <tuple>
+
+enum server_message_type : uint32_t
+{
+    msg_job = 16,      // client -> server: render_job
+    msg_progress = 17, // server -> client: progress_header followed by float RGB pixels
+    msg_done = 18      // server -> client: the last progress message has been sent
+};
+
+struct render_job
+{
+    render_config config;
+    int32_t passes = 8; // Number of progressive updates to stream back
+};
+
+struct progress_header
+{
+    int32_t width, height;
+    int32_t samples_done, samples_total;
+};
+
+class render_server
+{
+  public:
+    size_t max_scenes = 4; // Scenes kept between jobs, least recently used evicted first
+
+    int serve(const endpoint& ep)
+    {
+        // Accepts clients one at a time and runs their jobs until the process is stopped.
+        // Each job already uses every core, so jobs are simply queued behind each other.
+        int listener = open_listener(ep);
+        if (listener < 0)
+        {
+            std::cerr << "server: could not listen: " << std::strerror(errno) << '\n';
+            return 1;
+        }
+
+        std::clog << "Render server ready." << std::endl;
+        while (true)
+        {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+
+            uint32_t type;
+            std::vector<char> payload;
+            while (recv_message(fd, type, payload))
+            {
+                if (type != msg_job || payload.size() != sizeof(render_job))
+                    break;
+
+                render_job job;
+                std::memcpy(&job, payload.data(), sizeof(job));
+                if (!run_job(fd, job))
+                    break;
+            }
+            close(fd);
+        }
+
+        close(listener);
+        return 0;
+    }
+
+  private:
+    // Only the scene id, primitive count, acceleration structure, node layout and light
+    // sampler determine the world; everything else in the config is a camera or sampling
+    // setting applied per job.
+    using scene_key = std::tuple<int32_t, int32_t, int32_t, int32_t, int32_t>;
+
+    struct cached_scene
+    {
+        std::shared_ptr<const scene> s;
+        uint64_t last_used;
+    };
+
+    std::map<scene_key, cached_scene> cache;
+    uint64_t jobs_started = 0;
+
+    std::shared_ptr<const scene> get_scene(const render_config& config)
+    {
+        scene_key key{config.scene_id, config.primitive_count, config.accel, config.node_layout,
+                      config.light_sampler};
+        jobs_started++;
+        auto it = cache.find(key);
+        if (it != cache.end())
+        {
+            it->second.last_used = jobs_started;
+            return it->second.s;
+        }
+
+        // Evict before building, so the new scene never shares memory with a full cache.
+        while (!cache.empty() && cache.size() >= max_scenes)
+        {
+            auto oldest = std::min_element(cache.begin(), cache.end(),
+                                           [](const auto& a, const auto& b)
+                                           { return a.second.last_used < b.second.last_used; });
+            std::clog << "Evicted scene " << std::get<0>(oldest->first) << std::endl;
+            cache.erase(oldest);
+        }
+
+        auto start_time = std::chrono::steady_clock::now();
+        auto s = std::make_shared<const scene>(build_scene(config));
+        auto seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        std::clog << "Built scene " << config.scene_id << " in " << seconds << "s" << std::endl;
+
+        if (max_scenes > 0)
+            cache.emplace(key, cached_scene{s, jobs_started});
+        return s;
+    }
+
+    bool run_job(int fd, const render_job& job)
+    {
+        // Returns false if the client went away.
+        auto s = get_scene(job.config);
+
+        camera cam = s->cam;
+        configure_camera(cam, job.config);
+        cam.initialize();
+
+        int image_width = cam.image_width;
+        int image_height = cam.get_image_height();
+        int spp = cam.samples_per_pixel;
+        int passes = std::max(1, std::min(job.passes, spp));
+
+        std::vector<color> sums(size_t(image_width) * image_height);
+        std::vector<float> pixels(sums.size() * 3);
+        std::vector<char> reply(sizeof(progress_header) + pixels.size() * sizeof(float));
+
+        auto start_time = std::chrono::steady_clock::now();
+        int samples_done = 0;
+        for (int pass = 0; pass < passes; pass++)
+        {
+            int pass_end = int(int64_t(spp) * (pass + 1) / passes);
+            render_tile_parallel(cam, s->world, s->lights, tile(0, 0, image_width, image_height),
+                                 samples_done, pass_end, sums.data());
+            samples_done = pass_end;
+
+            for (size_t i = 0; i < sums.size(); i++)
+            {
+                auto average = sums[i] / samples_done;
+                pixels[3 * i + 0] = float(average.x());
+                pixels[3 * i + 1] = float(average.y());
+                pixels[3 * i + 2] = float(average.z());
+            }
+
+            progress_header header{image_width, image_height, samples_done, spp};
+            std::memcpy(reply.data(), &header, sizeof(header));
+            std::memcpy(reply.data() + sizeof(header), pixels.data(),
+                        pixels.size() * sizeof(float));
+            if (!send_message(fd, msg_progress, reply.data(), reply.size()))
+                return false;
+        }
+
+        auto seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        std::clog << "Job: " << image_width << 'x' << image_height << ", " << spp << " spp in "
+                  << seconds << "s" << std::endl;
+
+        return send_message(fd, msg_done, nullptr, 0);
+    }
+};
+
+inline int submit_job(const endpoint& ep, const render_job& job)
+{
+    // Sends one job to a render server, reports its progress and writes the final image to
+    // std::cout.
+    int fd = open_connection(ep);
+    if (fd < 0)
+    {
+        std::cerr << "submit: could not connect to server\n";
+        return 1;
+    }
+
+    if (!send_message(fd, msg_job, &job, sizeof(job)))
+    {
+        close(fd);
+        return 1;
+    }
+
+    uint32_t type = 0;
+    std::vector<char> payload, last_image;
+    progress_header header{};
+    bool valid = true;
+    while (recv_message(fd, type, payload) && type == msg_progress)
+    {
+        // Every progress message must hold exactly the image its header describes.
+        valid = payload.size() >= sizeof(header);
+        if (valid)
+        {
+            std::memcpy(&header, payload.data(), sizeof(header));
+            size_t pixel_bytes = size_t(header.width) * header.height * 3 * sizeof(float);
+            valid = header.width > 0 && header.height > 0 &&
+                    payload.size() == sizeof(header) + pixel_bytes;
+        }
+        if (!valid)
+            break;
+
+        std::clog << "\rSamples: " << header.samples_done << '/' << header.samples_total << ' '
+                  << std::flush;
+        last_image.swap(payload);
+    }
+    close(fd);
+
+    if (!valid || type != msg_done || last_image.empty())
+    {
+        std::cerr << "\nsubmit: server closed the connection\n";
+        return 1;
+    }
+    std::clog << "\rDone.                 \n";
+
+    std::memcpy(&header, last_image.data(), sizeof(header));
+    auto pixels = reinterpret_cast<const float*>(last_image.data() + sizeof(header));
+
+    std::cout << "P3\n" << header.width << ' ' << header.height << "\n255\n";
+    for (size_t i = 0; i < size_t(header.width) * header.height; i++)
+        write_color(std::cout, color(pixels[3 * i], pixels[3 * i + 1], pixels[3 * i + 2]));
+
+    return 0;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "rtweekend.h"
+
+#include "plane.h"
+#include "quad.h"
+#include "sphere.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <string>
+
+// Fuzz test of hit_record::spawn_ray() and the hit point error bounds behind it. Spheres,
+// planes and quads of several sizes, placed at several distances from the origin, are hit by
+// random rays. Every hit spawns a ray to each side of the surface, searched from t = 0. The
+// ray leaving the surface must not hit the primitive again, and the ray entering a sphere
+// must reach its far side rather than hit the near side at once. The same rays spawned the
+// old way, from the hit point itself and searched from t = 0.001, are counted for
+// comparison. Exits with status 1 if a spawned ray fails anywhere the primitives are well
+// above the spacing of doubles at their position; no offset can work below it.
+
+std::mt19937_64 rng(3);
+std::uniform_real_distribution<double> uniform(-1, 1);
+
+vec3 random_direction()
+{
+    while (true)
+    {
+        vec3 v(uniform(rng), uniform(rng), uniform(rng));
+        auto lensq = v.length_squared();
+        if (1e-4 < lensq && lensq <= 1)
+            return v / std::sqrt(lensq);
+    }
+}
+
+struct spawn_counts
+{
+    long spawns = 0;
+    long failed = 0;     // Self-hits or lost hits of rays spawned with the error offset
+    long failed_old = 0; // The same for rays from the hit point, searched from 0.001
+};
+
+spawn_counts fuzz(double scale, double distance, int rays, shared_ptr<material> mat)
+{
+    spawn_counts counts;
+    for (int k = 0; k < rays; k++)
+    {
+        int kind = k % 3; // 0 sphere, 1 plane, 2 quad
+        point3 center(uniform(rng) * scale * 10 + distance,
+                      uniform(rng) * scale * 10 + distance * 0.7,
+                      uniform(rng) * scale * 10 - distance * 0.3);
+
+        shared_ptr<hittable> object;
+        double radius = scale * (0.1 + std::fabs(uniform(rng)));
+        if (kind == 0)
+        {
+            object = make_shared<sphere>(center, radius, mat);
+        }
+        else if (kind == 1)
+        {
+            object = make_shared<plane>(center, random_direction(), mat);
+        }
+        else
+        {
+            vec3 u = random_direction() * scale, v = random_direction() * scale;
+            object = make_shared<quad>(center - 0.5 * (u + v), u, v, mat);
+        }
+
+        point3 origin = center + random_direction() * scale * 30;
+        point3 target = center + vec3(uniform(rng), uniform(rng), uniform(rng)) * scale * 0.05;
+        hit_record rec;
+        if (!object->hit(ray(origin, target - origin), interval(0, infinity), rec))
+            continue;
+
+        for (int side = 0; side < 2; side++)
+        {
+            // Side 0 leaves the surface, side 1 goes through it.
+            vec3 direction = random_direction();
+            if ((dot(direction, rec.normal) > 0) != (side == 0))
+                direction = -direction;
+
+            hit_record next, next_old;
+            bool hit = object->hit(rec.spawn_ray(direction, 0, true), interval(0, infinity),
+                                   next);
+            bool hit_old = object->hit(ray(rec.p, direction, 0, true),
+                                       interval(0.001, infinity), next_old);
+
+            counts.spawns++;
+            if (kind == 0 && side == 1)
+            {
+                // The chord through the sphere; a hit much nearer than its far end is the near
+                // side again.
+                double chord = -2 * dot(direction, rec.normal) * radius;
+                counts.failed += !hit || next.t < 1e-3 * chord;
+                counts.failed_old += !hit_old || next_old.t < 1e-3 * chord;
+            }
+            else
+            {
+                counts.failed += hit;
+                counts.failed_old += hit_old;
+            }
+        }
+    }
+    return counts;
+}
+
+int main(int argc, char* argv[])
+{
+    int rays = 200000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        auto arg = std::string(argv[i]);
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--rays" && has_value)
+            rays = std::max(1, std::atoi(argv[++i]));
+        else
+        {
+            std::cerr << "Usage: spawn_fuzz [options]\n"
+                         "  --rays <n>   Rays per scale and distance (default 200000)\n";
+            return 1;
+        }
+    }
+
+    auto mat = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    bool ok = true;
+    for (double scale : {1e-4, 1.0, 1e6})
+    {
+        for (double distance : {0.0, 1e8, 1e13})
+        {
+            auto counts = fuzz(scale, distance, rays, mat);
+            auto percent = [&](long n)
+            { return counts.spawns > 0 ? 100.0 * n / counts.spawns : 0.0; };
+
+            // Doubles near 1e13 are about 2e-3 apart, too coarse for primitives of size 1e-4.
+            // Primitives a hundred times the spacing are held to the test.
+            double spacing = distance * std::numeric_limits<double>::epsilon();
+            bool resolvable = scale > 100 * spacing;
+            if (resolvable && counts.failed > 0)
+                ok = false;
+
+            std::printf("scale %g, distance %g: spawns %ld, failed %ld (%.4f%%), failed with "
+                        "epsilon 0.001 %ld (%.4f%%)%s\n",
+                        scale, distance, counts.spawns, counts.failed, percent(counts.failed),
+                        counts.failed_old, percent(counts.failed_old),
+                        resolvable ? "" : ", below double resolution");
+        }
+    }
+
+    if (!ok)
+    {
+        std::cerr << "spawn_fuzz: spawned rays hit the surface they left\n";
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -2,10 +2,15 @@
 #define SPHERE_H
 
 #include "hittable.h"
+#include "light_bounds.h"
+#include "material.h"
+#include "onb.h"
+#include "traversal_stats.h"
 
 class sphere : public hittable
 {
   public:
+    // Stationary sphere
     sphere(const point3& center, double radius, shared_ptr<material> mat)
         : center(center), radius(std::fmax(0, radius)), mat(mat)
     {
@@ -13,10 +18,21 @@ class sphere : public hittable
         bbox = aabb(center - rvec, center + rvec);
     }
 
+    // Moving sphere, at center1 at time 0 and center2 at time 1. Light sampling sees it at
+    // center1, so it should not be used as a light.
+    sphere(const point3& center1, const point3& center2, double radius,
+           shared_ptr<material> mat)
+        : center(center1), motion(center2 - center1), radius(std::fmax(0, radius)), mat(mat)
+    {
+        bbox = aabb(bounds_at(0), bounds_at(1));
+    }
+
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override
     {
-        vec3 oc = center - r.origin();
-        auto a = r.direction().length_squared();
+        COUNT_TRAVERSAL(primitives, 1);
+        point3 current_center = center_at(r.time());
+        vec3 oc = current_center - r.origin();
+        auto a = r.has_unit_direction() ? 1.0 : r.direction().length_squared();
         auto h = dot(r.direction(), oc);
         auto c = oc.length_squared() - radius * radius;
 
@@ -35,22 +51,137 @@ class sphere : public hittable
                 return false;
         }
 
+        // Reproject the hit point onto the sphere, which bounds its error by the few
+        // operations from the center instead of by the error of the root (as in pbrt).
         rec.t = root;
-        rec.p = r.at(rec.t);
-        vec3 outward_normal = (rec.p - center) / radius;
+        vec3 offset = r.at(rec.t) - current_center;
+        offset *= radius / offset.length();
+        rec.p = current_center + offset;
+        rec.p_error = gamma_bound(5) * abs(offset) + gamma_bound(3) * abs(rec.p);
+        vec3 outward_normal = offset / radius;
         rec.set_face_normal(r, outward_normal);
         rec.mat = mat;
+        rec.object = this;
 
         return true;
     }
 
+    bool occluded(const ray& r, interval ray_t) const override
+    {
+        COUNT_TRAVERSAL(primitives, 1);
+        point3 current_center = center_at(r.time());
+        vec3 oc = current_center - r.origin();
+        auto a = r.has_unit_direction() ? 1.0 : r.direction().length_squared();
+        auto h = dot(r.direction(), oc);
+        auto c = oc.length_squared() - radius * radius;
+
+        auto discriminant = h * h - a * c;
+        if (discriminant < 0)
+            return false;
+
+        auto sqrtd = std::sqrt(discriminant);
+        return ray_t.surrounds((h - sqrtd) / a) || ray_t.surrounds((h + sqrtd) / a);
+    }
+
     aabb bounding_box() const override { return bbox; }
 
+    aabb bounds_at(double time) const override
+    {
+        auto rvec = vec3(radius, radius, radius);
+        point3 c = center_at(time);
+        return aabb(c - rvec, c + rvec);
+    }
+
+    aabb clipped_box(const aabb& region) const override
+    {
+        // Within the region, the sphere reaches along an axis no further from its center than
+        // the radius of its cross-section through the point of the region's extent on the
+        // other two axes that lies nearest the center. Padded for rounding. A moving sphere
+        // keeps its whole box.
+        if (motion.length_squared() > 0)
+            return bbox;
+
+        double gap2[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const interval& ax = region.axis_interval(axis);
+            double gap = std::fmax(0, std::fmax(ax.min - center[axis], center[axis] - ax.max));
+            gap2[axis] = gap * gap;
+        }
+
+        interval extent[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            double r2 = radius * radius - (gap2[0] + gap2[1] + gap2[2] - gap2[axis]);
+            if (r2 < 0)
+                return aabb::empty;
+
+            double reach = std::sqrt(r2) + 1e-9 * radius;
+            extent[axis] = interval(center[axis] - reach, center[axis] + reach);
+        }
+        return aabb(extent[0], extent[1], extent[2]);
+    }
+
+    double pdf_value(const point3& origin, const vec3& direction) const override
+    {
+        // Directions are sampled uniformly inside the cone the sphere subtends from `origin`.
+        double cos_theta_max;
+        vec3 to_center = center - origin;
+        if (!subtended_cone(to_center, cos_theta_max))
+            return 0;
+
+        if (dot(unit_vector(direction), unit_vector(to_center)) < cos_theta_max)
+            return 0;
+
+        return uniform_cone_pdf(cos_theta_max);
+    }
+
+    bool emitter_bounds(light_bounds& lb) const override
+    {
+        color L = mat->emission();
+        auto radiance = (L.x() + L.y() + L.z()) / 3;
+        if (radiance <= 0)
+            return false;
+
+        // A sphere emits in every direction: the normal cone is the whole sphere (cos pi) and
+        // each point emits over its hemisphere (cos pi/2).
+        auto area = 4 * pi * radius * radius;
+        lb = light_bounds(bbox, vec3(0, 0, 1), pi * area * radiance, -1, 0, false);
+        return true;
+    }
+
+    vec3 random(const point3& origin, const vec3& u) const override
+    {
+        double cos_theta_max;
+        vec3 to_center = center - origin;
+        if (!subtended_cone(to_center, cos_theta_max))
+            return sample_uniform_sphere(u[0], u[1]);
+
+        onb uvw(unit_vector(to_center));
+        return uvw.transform(sample_uniform_cone(u[0], u[1], cos_theta_max));
+    }
+
   private:
-    point3 center;
+    point3 center; // At time 0
+    vec3 motion;   // Distance moved from time 0 to 1
     double radius;
     shared_ptr<material> mat;
     aabb bbox;
+
+    point3 center_at(double time) const { return center + time * motion; }
+
+    bool subtended_cone(const vec3& to_center, double& cos_theta_max) const
+    {
+        // Computes the cosine of the half-angle of the cone the sphere subtends. Returns false
+        // when the origin is inside the sphere, where no cone exists.
+        auto dist_squared = to_center.length_squared();
+        auto sin2_theta_max = radius * radius / dist_squared;
+        if (sin2_theta_max >= 1)
+            return false;
+
+        cos_theta_max = std::sqrt(1 - sin2_theta_max);
+        return true;
+    }
 };
 
 #endif
\ No newline at end of file
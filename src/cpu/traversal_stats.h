@@ -0,0 +1,113 @@
+#ifndef TRAVERSAL_STATS_H
+#define TRAVERSAL_STATS_H
+
+// Counts of the work that ray queries do: queries against the world, BVH nodes visited and
+// primitives tested. Counting costs a thread-local increment per step, so it is compiled in
+// only when TRAVERSAL_STATS is defined as 1, e.g. with -DTRAVERSAL_STATS=1; otherwise
+// COUNT_TRAVERSAL expands to nothing and the totals read 0.
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#ifndef TRAVERSAL_STATS
+#define TRAVERSAL_STATS 0
+#endif
+
+struct traversal_counts
+{
+    uint64_t rays = 0;
+    uint64_t nodes = 0;
+    uint64_t primitives = 0;
+
+    void add(const traversal_counts& other)
+    {
+        rays += other.rays;
+        nodes += other.nodes;
+        primitives += other.primitives;
+    }
+};
+
+class traversal_stats
+{
+  public:
+    // The counts of the calling thread.
+    static traversal_counts& local()
+    {
+        thread_local registration counters;
+        return counters.counts;
+    }
+
+    // The sum over every thread, including ones that have exited. Only exact while no
+    // queries are running.
+    static traversal_counts total()
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        traversal_counts sum = retired();
+        for (const auto* counts : live())
+            sum.add(*counts);
+        return sum;
+    }
+
+    static void reset()
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        retired() = traversal_counts();
+        for (auto* counts : live())
+            *counts = traversal_counts();
+    }
+
+  private:
+    struct registration
+    {
+        traversal_counts counts;
+
+        registration()
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            live().push_back(&counts);
+        }
+
+        ~registration()
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            retired().add(counts);
+            auto& threads = live();
+            for (size_t i = 0; i < threads.size(); i++)
+            {
+                if (threads[i] == &counts)
+                {
+                    threads[i] = threads.back();
+                    threads.pop_back();
+                    break;
+                }
+            }
+        }
+    };
+
+    static std::mutex& registry_mutex()
+    {
+        static std::mutex m;
+        return m;
+    }
+
+    static std::vector<traversal_counts*>& live()
+    {
+        static std::vector<traversal_counts*> threads;
+        return threads;
+    }
+
+    static traversal_counts& retired()
+    {
+        static traversal_counts counts;
+        return counts;
+    }
+};
+
+#if TRAVERSAL_STATS
+#define COUNT_TRAVERSAL(counter, n) (traversal_stats::local().counter += (n))
+#else
+#define COUNT_TRAVERSAL(counter, n) ((void)0)
+#endif
+
+#endif
\ No newline at end of file
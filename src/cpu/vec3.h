@@ -105,39 +105,14 @@ inline vec3 cross(const vec3& u, const vec3& v)
                 u.e[0] * v.e[1] - u.e[1] * v.e[0]);
 }
 
-inline vec3 unit_vector(const vec3& v)
-{
-    return v / v.length();
-}
-
-inline vec3 random_unit_vector()
-{
-    while (true)
-    {
-        auto p = vec3::random(-1, 1);
-        auto lensq = p.length_squared();
-        if (1e-160 < lensq && lensq <= 1)
-            return p / sqrt(lensq);
-    }
-}
-
-inline vec3 random_in_unit_disk()
+inline vec3 abs(const vec3& v)
 {
-    while (true)
-    {
-        auto p = vec3(random_double(-1, 1), random_double(-1, 1), 0);
-        if (p.length_squared() < 1)
-            return p;
-    }
+    return vec3(std::fabs(v.e[0]), std::fabs(v.e[1]), std::fabs(v.e[2]));
 }
 
-inline vec3 random_on_hemisphere(const vec3& normal)
+inline vec3 unit_vector(const vec3& v)
 {
-    vec3 on_unit_sphere = random_unit_vector();
-    if (dot(on_unit_sphere, normal) > 0.0) // In the same hemisphere as the normal
-        return on_unit_sphere;
-    else
-        return -on_unit_sphere;
+    return v / v.length();
 }
 
 inline vec3 reflect(const vec3& v, const vec3& n)
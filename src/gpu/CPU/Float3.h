@@ -0,0 +1,101 @@
+#pragma once
+
+// Portable stand-in for the Metal/simd float3: three floats padded to 16 bytes and aligned
+// like simd::float3, so buffers laid out for the GPU kernel can be used as they are.
+
+#include <cmath>
+
+struct alignas(16) float3
+{
+    float x, y, z;
+
+    float3() = default;
+    constexpr float3(float x, float y, float z) : x(x), y(y), z(z) {}
+
+    float operator[](int i) const { return i == 0 ? x : (i == 1 ? y : z); }
+
+    float3 operator-() const { return float3(-x, -y, -z); }
+
+    float3& operator+=(const float3& v)
+    {
+        x += v.x;
+        y += v.y;
+        z += v.z;
+        return *this;
+    }
+
+    float3& operator*=(const float3& v)
+    {
+        x *= v.x;
+        y *= v.y;
+        z *= v.z;
+        return *this;
+    }
+};
+
+static_assert(sizeof(float3) == 16 && alignof(float3) == 16, "float3 must match simd::float3");
+
+inline float3 operator+(const float3& u, const float3& v)
+{
+    return float3(u.x + v.x, u.y + v.y, u.z + v.z);
+}
+
+inline float3 operator-(const float3& u, const float3& v)
+{
+    return float3(u.x - v.x, u.y - v.y, u.z - v.z);
+}
+
+inline float3 operator*(const float3& u, const float3& v)
+{
+    return float3(u.x * v.x, u.y * v.y, u.z * v.z);
+}
+
+inline float3 operator*(float t, const float3& v)
+{
+    return float3(t * v.x, t * v.y, t * v.z);
+}
+
+inline float3 operator*(const float3& v, float t)
+{
+    return t * v;
+}
+
+inline float3 operator/(const float3& v, float t)
+{
+    return float3(v.x / t, v.y / t, v.z / t);
+}
+
+// The functions below follow the Metal standard library definitions.
+
+inline float dot(const float3& u, const float3& v)
+{
+    return u.x * v.x + u.y * v.y + u.z * v.z;
+}
+
+inline float length_squared(const float3& v)
+{
+    return dot(v, v);
+}
+
+inline float3 normalize(const float3& v)
+{
+    return v / std::sqrt(length_squared(v));
+}
+
+inline float3 reflect(const float3& i, const float3& n)
+{
+    return i - 2.0f * dot(n, i) * n;
+}
+
+inline float3 refract(const float3& i, const float3& n, float eta)
+{
+    float k = 1.0f - eta * eta * (1.0f - dot(n, i) * dot(n, i));
+    if (k < 0.0f)
+        return float3(0.0f, 0.0f, 0.0f);
+    return eta * i - (eta * dot(n, i) + std::sqrt(k)) * n;
+}
+
+inline float3 mix(const float3& x, const float3& y, float a)
+{
+    return x + (y - x) * a;
+}
\ No newline at end of file
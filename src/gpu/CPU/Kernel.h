@@ -0,0 +1,315 @@
+#pragma once
+
+// Portable C++ port of the `render` kernel in Shaders.metal. It reads the same Camera and
+// Sphere buffers and reproduces the kernel's random number stream, so it renders the same
+// image as the GPU up to floating-point differences between the two math libraries.
+//
+// Two entry points are provided: render_pixel(), a scalar transcription of one GPU thread,
+// and render_packet(), which traces kPacketWidth neighbouring pixels together. The packet
+// keeps its rays in structure-of-arrays form so that intersection, which is the same for
+// every lane, compiles to SIMD code; shading diverges per material and runs lane by lane.
+// Both compute every value with the same operations, so with -ffp-contract=off they agree
+// bit for bit. The intersection loop only vectorizes with -fno-math-errno and
+// -fno-trapping-math, which the gpu_pt_cpu target sets.
+
+#define PT_CPU_KERNEL 1
+#include "../SharedTypes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+constexpr int kPacketWidth = 32;
+constexpr int kMaxDepth = 50;
+
+struct RNG
+{
+    uint32_t state;
+
+    void init(uint32_t x) { state = x; }
+
+    uint32_t next_uint()
+    {
+        state ^= state >> 17;
+        state *= 0xed5ad4bb;
+        state ^= state >> 11;
+        state *= 0xac4c1b51;
+        state ^= state >> 15;
+        state *= 0x31848bab;
+        state ^= state >> 14;
+        return state;
+    }
+
+    float next_float()
+    {
+        return float(next_uint()) / 4294967296.0f; // [0, 1)
+    }
+};
+
+struct Ray
+{
+    float3 orig;
+    float3 dir;
+
+    float3 at(float t) const { return orig + t * dir; }
+};
+
+inline float3 random_unit_vector(RNG& seed)
+{
+    float z = 1.0f - 2.0f * seed.next_float();
+    float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    float phi = 2.0f * float(M_PI) * seed.next_float();
+    return float3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+inline float linear_to_gamma(float linear_component)
+{
+    if (linear_component > 0)
+        return std::sqrt(linear_component);
+
+    return 0;
+}
+
+inline float reflectance(float cosine, float refraction_index)
+{
+    // Use Schlick's approximation for reflectance.
+    float r0 = (1.0f - refraction_index) / (1.0f + refraction_index);
+    r0 = r0 * r0;
+    return r0 + (1.0f - r0) * std::pow((1.0f - cosine), 5.0f);
+}
+
+inline bool hit_sphere(const Sphere& s, const Ray& r, float ray_tmin, float ray_tmax, float& t)
+{
+    float3 oc = s.center - r.orig;
+    float a = length_squared(r.dir);
+    float h = dot(r.dir, oc);
+    float c = length_squared(oc) - s.radius * s.radius;
+
+    float discriminant = h * h - a * c;
+    if (discriminant < 0)
+        return false;
+
+    float sqrtd = std::sqrt(discriminant);
+
+    // Find the nearest root that lies in the acceptable range.
+    float root = (h - sqrtd) / a;
+    if (root <= ray_tmin || ray_tmax <= root)
+    {
+        root = (h + sqrtd) / a;
+        if (root <= ray_tmin || ray_tmax <= root)
+            return false;
+    }
+
+    t = root;
+    return true;
+}
+
+inline void scatter(const Sphere& s, float t, Ray& ray, float3& attenuation, RNG& seed)
+{
+    // The body of the kernel's bounce loop for a ray that hit sphere `s` at distance `t`:
+    // replaces `ray` with the scattered ray and updates the path throughput.
+    float3 p = ray.at(t);
+    float3 outward_normal = (p - s.center) / s.radius;
+    bool front_face = dot(ray.dir, outward_normal) < 0;
+    float3 normal = front_face ? outward_normal : -outward_normal;
+    const Material& mat = s.mat;
+
+    if (mat.type == LAMBERTIAN)
+    {
+        float3 scatter_direction = normal + random_unit_vector(seed);
+        ray = Ray{p, scatter_direction};
+        attenuation *= mat.lambertian.albedo;
+    }
+    else if (mat.type == METAL)
+    {
+        float fuzz = mat.metal.fuzz < 1.0f ? mat.metal.fuzz : 1.0f;
+        float3 reflected = reflect(ray.dir, normal);
+        reflected = normalize(reflected) + (fuzz * random_unit_vector(seed));
+        ray = Ray{p, reflected};
+
+        if (dot(ray.dir, normal) > 0)
+            attenuation *= mat.metal.albedo;
+    }
+    else if (mat.type == DIELECTRIC)
+    {
+        float ri = front_face ? (1.0f / mat.dielectric.refraction_index)
+                              : mat.dielectric.refraction_index;
+
+        float3 unit_direction = normalize(ray.dir);
+        float cos_theta = std::fmin(dot(-unit_direction, normal), 1.0f);
+        float sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
+
+        bool cannot_refract = ri * sin_theta > 1.0f;
+        float3 direction;
+
+        if (cannot_refract || reflectance(cos_theta, ri) > seed.next_float())
+            direction = reflect(unit_direction, normal);
+        else
+            direction = refract(unit_direction, normal, ri);
+
+        ray = Ray{p, direction};
+    }
+}
+
+inline float3 sky_color(const Ray& r)
+{
+    float3 unit_direction = normalize(r.dir);
+    float a = 0.5f * (unit_direction.y + 1.0f);
+    return mix(float3(1.0f, 1.0f, 1.0f), float3(0.5f, 0.7f, 1.0f), a);
+}
+
+inline Ray camera_ray(const Camera& c, uint32_t x, uint32_t y, RNG& seed)
+{
+    float ox = seed.next_float() - 0.5f;
+    float oy = seed.next_float() - 0.5f;
+    float3 pixel_sample = c.pixel00_loc + ((x + ox) * c.pixel_delta_u) +
+                          ((y + oy) * c.pixel_delta_v);
+    return Ray{c.center, pixel_sample - c.center};
+}
+
+inline float3 ray_color(const Ray& r, const Sphere* world, uint32_t count, RNG& seed)
+{
+    Ray curr_ray = r;
+    float3 curr_attenuation = float3(1.0f, 1.0f, 1.0f);
+
+    for (int i = 0; i < kMaxDepth; i++)
+    {
+        float closest_so_far = std::numeric_limits<float>::infinity();
+        int hit_index = -1;
+        for (uint32_t k = 0; k < count; k++)
+        {
+            float t;
+            if (hit_sphere(world[k], curr_ray, 0.001f, closest_so_far, t))
+            {
+                closest_so_far = t;
+                hit_index = int(k);
+            }
+        }
+
+        if (hit_index < 0)
+            return curr_attenuation * sky_color(curr_ray);
+
+        scatter(world[hit_index], closest_so_far, curr_ray, curr_attenuation, seed);
+    }
+    return float3(0.0f, 0.0f, 0.0f);
+}
+
+inline float3 render_pixel(const Camera& c, const Sphere* world, uint32_t count, uint32_t x,
+                           uint32_t y)
+{
+    // What one thread of the GPU kernel computes for pixel (x, y).
+    RNG seed;
+    seed.init(y * c.image_width + x);
+
+    float3 color_acc(0.0f, 0.0f, 0.0f);
+    for (uint32_t s = 0; s < c.samples_per_pixel; s++)
+        color_acc += ray_color(camera_ray(c, x, y, seed), world, count, seed);
+
+    return float3(linear_to_gamma(color_acc.x / c.samples_per_pixel),
+                  linear_to_gamma(color_acc.y / c.samples_per_pixel),
+                  linear_to_gamma(color_acc.z / c.samples_per_pixel));
+}
+
+inline void render_packet(const Camera& c, const Sphere* world, uint32_t count, uint32_t x0,
+                          uint32_t y, float3* out)
+{
+    // Renders up to kPacketWidth pixels of row `y`, starting at x0, into `out`, which points
+    // at pixel x0 of the image. After every bounce the lanes whose paths ended are compacted
+    // away, so the vector loops only run over live rays however much the paths diverge.
+    int lanes = int(std::min<uint32_t>(kPacketWidth, c.image_width - x0));
+
+    RNG seed[kPacketWidth];
+    float3 color_acc[kPacketWidth];
+    for (int l = 0; l < lanes; l++)
+    {
+        seed[l].init(y * c.image_width + x0 + l);
+        color_acc[l] = float3(0.0f, 0.0f, 0.0f);
+    }
+
+    alignas(32) float ox[kPacketWidth], oy[kPacketWidth], oz[kPacketWidth];
+    alignas(32) float dx[kPacketWidth], dy[kPacketWidth], dz[kPacketWidth];
+    alignas(32) float closest[kPacketWidth];
+    alignas(32) int hit_index[kPacketWidth];
+    int live[kPacketWidth]; // Lanes of the paths still being traced
+    Ray rays[kPacketWidth];
+    float3 attenuation[kPacketWidth];
+
+    for (uint32_t s = 0; s < c.samples_per_pixel; s++)
+    {
+        for (int l = 0; l < lanes; l++)
+        {
+            rays[l] = camera_ray(c, x0 + l, y, seed[l]);
+            attenuation[l] = float3(1.0f, 1.0f, 1.0f);
+            live[l] = l;
+        }
+
+        int live_count = lanes;
+        for (int depth = 0; depth < kMaxDepth && live_count > 0; depth++)
+        {
+            for (int m = 0; m < live_count; m++)
+            {
+                const Ray& r = rays[live[m]];
+                ox[m] = r.orig.x;
+                oy[m] = r.orig.y;
+                oz[m] = r.orig.z;
+                dx[m] = r.dir.x;
+                dy[m] = r.dir.y;
+                dz[m] = r.dir.z;
+                closest[m] = std::numeric_limits<float>::infinity();
+                hit_index[m] = -1;
+            }
+
+            // Every live ray tests the same sphere at once; the branches of hit_sphere()
+            // become selects so that this loop vectorizes.
+            for (uint32_t k = 0; k < count; k++)
+            {
+                const float cx = world[k].center.x, cy = world[k].center.y;
+                const float cz = world[k].center.z, r2 = world[k].radius * world[k].radius;
+                for (int m = 0; m < live_count; m++)
+                {
+                    float ocx = cx - ox[m], ocy = cy - oy[m], ocz = cz - oz[m];
+                    float a = dx[m] * dx[m] + dy[m] * dy[m] + dz[m] * dz[m];
+                    float h = dx[m] * ocx + dy[m] * ocy + dz[m] * ocz;
+                    float cc = (ocx * ocx + ocy * ocy + ocz * ocz) - r2;
+
+                    float discriminant = h * h - a * cc;
+                    float sqrtd = std::sqrt(std::max(discriminant, 0.0f));
+                    float near_root = (h - sqrtd) / a;
+                    float far_root = (h + sqrtd) / a;
+
+                    // Bitwise & and | keep the conditions free of branches.
+                    bool near_ok = (near_root > 0.001f) & (near_root < closest[m]);
+                    bool far_ok = (far_root > 0.001f) & (far_root < closest[m]);
+                    bool hit = (discriminant >= 0) & (near_ok | far_ok);
+
+                    float root = near_ok ? near_root : far_root;
+                    closest[m] = hit ? root : closest[m];
+                    hit_index[m] = hit ? int(k) : hit_index[m];
+                }
+            }
+
+            int next_count = 0;
+            for (int m = 0; m < live_count; m++)
+            {
+                int l = live[m];
+                if (hit_index[m] < 0)
+                {
+                    color_acc[l] += attenuation[l] * sky_color(rays[l]);
+                    continue;
+                }
+
+                scatter(world[hit_index[m]], closest[m], rays[l], attenuation[l], seed[l]);
+                live[next_count++] = l;
+            }
+            live_count = next_count;
+        }
+    }
+
+    for (int l = 0; l < lanes; l++)
+    {
+        out[l] = float3(linear_to_gamma(color_acc[l].x / c.samples_per_pixel),
+                        linear_to_gamma(color_acc[l].y / c.samples_per_pixel),
+                        linear_to_gamma(color_acc[l].z / c.samples_per_pixel));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "Kernel.h"
+
+#include "../Scene.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <execution>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::high_resolution_clock;
+
+int main(int argc, char* argv[])
+{
+    uint32_t image_width = 400, samples_per_pixel = 100;
+    bool scalar = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        auto arg = std::string(argv[i]);
+        if (arg == "--width" && i + 1 < argc)
+            image_width = uint32_t(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--spp" && i + 1 < argc)
+            samples_per_pixel = uint32_t(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--scalar")
+            scalar = true;
+        else
+        {
+            std::cerr << "Usage: gpu_pt_cpu [--width <px>] [--spp <n>] [--scalar] > image.ppm\n"
+                         "  --scalar  Trace one pixel at a time instead of in packets\n";
+            return 1;
+        }
+    }
+
+    Camera c;
+    std::vector<Sphere> world;
+    build_scene(c, world, image_width, samples_per_pixel);
+    uint32_t count = static_cast<uint32_t>(world.size());
+
+    std::vector<float3> pixels(size_t(c.image_width) * c.image_height);
+    std::vector<uint32_t> rows(c.image_height);
+    std::iota(rows.begin(), rows.end(), 0);
+
+    auto timerStart = Clock::now();
+
+    // Rows play the role of the GPU's threadgroups; each is traced in packets of pixels.
+    std::for_each(std::execution::par, rows.begin(), rows.end(),
+                  [&](uint32_t j)
+                  {
+                      float3* row = &pixels[size_t(j) * c.image_width];
+                      if (scalar)
+                      {
+                          for (uint32_t i = 0; i < c.image_width; i++)
+                              row[i] = render_pixel(c, world.data(), count, i, j);
+                      }
+                      else
+                      {
+                          for (uint32_t i = 0; i < c.image_width; i += kPacketWidth)
+                              render_packet(c, world.data(), count, i, j, row + i);
+                      }
+                  });
+
+    auto timerEnd = Clock::now();
+
+    // Output an image
+    std::cout << "P3\n" << c.image_width << " " << c.image_height << "\n255\n";
+    for (const auto& pixel : pixels)
+    {
+        int ir = int(255.99 * pixel[0]);
+        int ig = int(255.99 * pixel[1]);
+        int ib = int(255.99 * pixel[2]);
+
+        std::cout << ir << " " << ig << " " << ib << "\n";
+    }
+
+    // Render time
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(timerEnd - timerStart);
+
+    std::clog << "Render time: " << std::chrono::duration_cast<std::chrono::hours>(ms).count()
+              << "h " << std::chrono::duration_cast<std::chrono::minutes>(ms).count() % 60 << "m "
+              << std::chrono::duration_cast<std::chrono::seconds>(ms).count() % 60 << "s "
+              << std::endl;
+    return 0;
+}
\ No newline at end of file
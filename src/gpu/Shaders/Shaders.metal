@@ -1,11 +1,11 @@
 #include <metal_stdlib>
+#include "../SharedTypes.h"
 #include "RNG.metal"
 #include "Utils.metal"
 #include "Ray.metal"
 #include "Material.metal"
 #include "Hittable.metal"
 #include "Sphere.metal"
-#include "Camera.metal"
 
 using namespace metal;
 
@@ -18,7 +18,7 @@ bool hit(constant Sphere* world, constant uint& count, thread const Ray& r, floa
 
     for (uint i = 0; i < count; i++)
     {
-        if (world[i].hit(r, ray_tmin, closest_so_far, temp_rec))
+        if (hit_sphere(world[i], r, ray_tmin, closest_so_far, temp_rec))
         {
             hit_anything = true;
             closest_so_far = temp_rec.t;
@@ -68,7 +68,7 @@ float3 ray_color(thread const Ray& r, constant Sphere* world, constant uint& cou
                 bool cannot_refract = ri * sin_theta > 1.0f;
                 float3 direction;
 
-                if (cannot_refract || Dielectric::reflectance(cos_theta, ri) > random_float(seed))
+                if (cannot_refract || reflectance(cos_theta, ri) > random_float(seed))
                     direction = metal::reflect(unit_direction, rec.normal);
                 else
                     direction = metal::refract(unit_direction, rec.normal, ri);
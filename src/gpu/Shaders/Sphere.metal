@@ -1,41 +1,36 @@
 #pragma once
 
-struct Sphere
-{
-    float3 center;
-    float radius;
-    Material mat;
+// The Sphere struct is defined in SharedTypes.h, shared with the host programs.
 
-    bool hit(thread const Ray& r, float ray_tmin, float ray_tmax,
-             thread HitRecord& rec) const constant
-    {
-        float3 oc = center - r.origin();
-        float a = metal::length_squared(r.direction());
-        float h = metal::dot(r.direction(), oc);
-        float c = metal::length_squared(oc) - radius * radius;
+bool hit_sphere(constant Sphere& s, thread const Ray& r, float ray_tmin, float ray_tmax,
+                thread HitRecord& rec)
+{
+    float3 oc = s.center - r.origin();
+    float a = metal::length_squared(r.direction());
+    float h = metal::dot(r.direction(), oc);
+    float c = metal::length_squared(oc) - s.radius * s.radius;
 
-        float discriminant = h * h - a * c;
-        if (discriminant < 0)
-            return false;
+    float discriminant = h * h - a * c;
+    if (discriminant < 0)
+        return false;
 
-        float sqrtd = metal::sqrt(discriminant);
+    float sqrtd = metal::sqrt(discriminant);
 
-        // Find the nearest root that lies in the acceptable range.
-        float root = (h - sqrtd) / a;
+    // Find the nearest root that lies in the acceptable range.
+    float root = (h - sqrtd) / a;
+    if (root <= ray_tmin || ray_tmax <= root)
+    {
+        root = (h + sqrtd) / a;
         if (root <= ray_tmin || ray_tmax <= root)
-        {
-            root = (h + sqrtd) / a;
-            if (root <= ray_tmin || ray_tmax <= root)
-                return false;
-        }
+            return false;
+    }
 
-        rec.t = root;
-        rec.p = r.at(rec.t);
+    rec.t = root;
+    rec.p = r.at(rec.t);
 
-        float3 outward_normal = (rec.p - center) / radius;
-        rec.set_face_normal(r, outward_normal);
-        rec.mat = mat;
+    float3 outward_normal = (rec.p - s.center) / s.radius;
+    rec.set_face_normal(r, outward_normal);
+    rec.mat = s.mat;
 
-        return true;
-    }
-};
\ No newline at end of file
+    return true;
+}
\ No newline at end of file
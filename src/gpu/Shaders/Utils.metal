@@ -25,13 +25,12 @@ float3 random(float min, float max, thread RNG& seed)
 
 float3 random_unit_vector(thread RNG& seed)
 {
-    while (true)
-    {
-        float3 p = random(-1.0f, 1.0f, seed);
-        float lensq = metal::length_squared(p);
-        if (1e-40f < lensq && lensq <= 1.0f)
-            return metal::normalize(p);
-    }
+    // Analytic uniform sphere sample: a fixed two draws per call, so threads in a SIMD group
+    // never diverge the way a rejection loop does.
+    float z = 1.0f - 2.0f * random_float(seed);
+    float r = metal::sqrt(metal::max(0.0f, 1.0f - z * z));
+    float phi = 2.0f * M_PI_F * random_float(seed);
+    return float3(r * metal::cos(phi), r * metal::sin(phi), z);
 }
 
 float3 random_on_hemisphere(thread const float3& normal, thread RNG& seed)
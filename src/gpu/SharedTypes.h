@@ -0,0 +1,73 @@
+#pragma once
+
+// Scene and camera layout read by the `render` kernel. This one definition is compiled three
+// ways: as Metal Shading Language by Shaders.metal, where float3 is the built-in vector type;
+// as C++ by the Metal host program, which uses simd::float3; and as C++ by the portable CPU
+// kernel (CPU/Kernel.h), which uses a layout-compatible float3. The same buffers therefore
+// feed either backend, and neither can drift from the other.
+
+#if defined(__METAL_VERSION__)
+#include <metal_stdlib>
+#elif defined(PT_CPU_KERNEL)
+#include "CPU/Float3.h"
+#include <cstdint>
+#else
+#include <cstdint>
+#include <simd/simd.h>
+using float3 = simd::float3;
+#endif
+
+struct Camera
+{
+    float3 pixel00_loc;
+    float3 pixel_delta_u;
+    float3 pixel_delta_v;
+    float3 center;
+    uint32_t image_width;
+    uint32_t image_height;
+    uint32_t samples_per_pixel;
+};
+
+enum MaterialType
+{
+    LAMBERTIAN,
+    METAL,
+    DIELECTRIC
+};
+
+struct Lambertian
+{
+    float3 albedo;
+};
+
+struct Metal
+{
+    float3 albedo;
+    float fuzz;
+};
+
+struct Dielectric
+{
+    float refraction_index;
+};
+
+struct Material
+{
+    MaterialType type;
+    union
+    {
+        Lambertian lambertian;
+        Metal metal;
+        Dielectric dielectric;
+    };
+};
+
+struct Sphere
+{
+    float3 center;
+    float radius;
+    Material mat;
+};
+
+static_assert(sizeof(Camera) == 80 && sizeof(Material) == 48 && sizeof(Sphere) == 80,
+              "Layout must match the buffers the host programs fill");
\ No newline at end of file
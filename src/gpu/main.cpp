@@ -13,119 +13,17 @@
 #include <Metal/Metal.hpp>
 #include <simd/simd.h>
 
-using Clock = std::chrono::high_resolution_clock;
-
-struct Camera
-{
-    simd::float3 pixel00_loc;
-    simd::float3 pixel_delta_u;
-    simd::float3 pixel_delta_v;
-    simd::float3 center;
-    uint image_width;
-    uint image_height;
-    uint samples_per_pixel;
-};
-
-enum MaterialType
-{
-    LAMBERTIAN,
-    METAL,
-    DIELECTRIC
-};
-
-struct Lambertian
-{
-    simd::float3 albedo;
-};
-
-struct Metal
-{
-    simd::float3 albedo;
-    float fuzz;
-};
+#include "Scene.h"
 
-struct Dielectric
-{
-    float refraction_index;
-};
-
-struct Material
-{
-    MaterialType type;
-    union
-    {
-        Lambertian lambertian;
-        Metal metal;
-        Dielectric dielectric;
-    };
-};
-
-struct Sphere
-{
-    simd::float3 center;
-    float radius;
-    Material mat;
-};
+using Clock = std::chrono::high_resolution_clock;
 
 int main()
 {
     Camera c;
-
-    // Image
-    const float aspect_ratio = 16.0 / 9.0;
-
-    c.image_width = 400;
-    c.image_height = int(c.image_width / aspect_ratio);
-    c.image_height = (c.image_height < 1) ? 1 : c.image_height;
-
-    int num_pixels = c.image_width * c.image_height;
-
-    // Camera
-    simd::float3 focal_length = simd::float3{0.0f, 0.0f, 1.0f};
-    auto viewport_height = 2.0f;
-    auto viewport_width = viewport_height * (float(c.image_width) / c.image_height);
-
-    c.center = simd::float3{0.0f, 0.0f, 0.0f};
-    auto viewport_u = simd::float3{viewport_width, 0, 0};
-    auto viewport_v = simd::float3{0, -viewport_height, 0};
-
-    c.pixel_delta_u = viewport_u / float(c.image_width);
-    c.pixel_delta_v = viewport_v / float(c.image_height);
-
-    auto viewport_upper_left = c.center - viewport_u * 0.5f - viewport_v * 0.5f - focal_length;
-    c.pixel00_loc = viewport_upper_left + 0.5f * (c.pixel_delta_u + c.pixel_delta_v);
-
-    c.samples_per_pixel = 100;
-
-    // World
     std::vector<Sphere> world;
+    build_scene(c, world);
 
-    Material material_ground;
-    material_ground.type = LAMBERTIAN;
-    material_ground.lambertian.albedo = simd::float3{0.8f, 0.8f, 0.0f};
-
-    Material material_center;
-    material_center.type = LAMBERTIAN;
-    material_center.lambertian.albedo = simd::float3{0.1f, 0.2f, 0.5f};
-
-    Material material_left;
-    material_left.type = DIELECTRIC;
-    material_left.dielectric.refraction_index = 1.5f;
-
-    Material material_bubble;
-    material_bubble.type = DIELECTRIC;
-    material_bubble.dielectric.refraction_index = 1.0f / 1.5f;
-
-    Material material_right;
-    material_right.type = METAL;
-    material_right.metal.albedo = simd::float3{0.8f, 0.6f, 0.2f};
-    material_right.metal.fuzz = 1.0;
-
-    world.push_back({simd::float3{0.0f, -100.5f, -1.0f}, 100.0f, material_ground});
-    world.push_back({simd::float3{0.0f, 0.0f, -1.2f}, 0.5f, material_center});
-    world.push_back({simd::float3{-1.0f, 0.0f, -1.0f}, 0.5f, material_left});
-    world.push_back({simd::float3{-1.0f, 0.0f, -1.0f}, 0.4f, material_bubble});
-    world.push_back({simd::float3{1.0f, 0.0f, -1.0f}, 0.5f, material_right});
+    int num_pixels = c.image_width * c.image_height;
 
     // C++ RAII
     NS::AutoreleasePool* pool = NS::AutoreleasePool::alloc()->init();